@@ -0,0 +1,102 @@
+/*
+  ==============================================================================
+
+    Adaptive just intonation for the notes currently held across MPE channels.
+
+  ==============================================================================
+*/
+
+#include "AdaptiveTuning.h"
+#include <math.h>
+
+// 5-limit just intervals within an octave.
+const double just_ratios[] = { 1.0, 16.0/15, 9.0/8, 6.0/5, 5.0/4, 4.0/3, 45.0/32, 3.0/2,
+                               8.0/5, 5.0/3, 16.0/9, 9.0/5, 15.0/8, 2.0 };
+
+AdaptiveTuning::AdaptiveTuning()
+{
+    for (int cents = 0; cents < 1200; cents++)
+    {
+        double nearest = 12;
+        for (double ratio : just_ratios)
+        {
+            double step = (1200 * log2(ratio) - cents) / 100;
+            if (fabs(step) < fabs(nearest)) nearest = step;
+        }
+        ji_correction[cents] = fabs(nearest) <= adaptive_max_correction ? nearest : 0;
+    }
+    reset();
+}
+
+void AdaptiveTuning::reset()
+{
+    for (int c = 0; c < 16; c++)
+    {
+        correction[c] = 0;
+        pitch[c] = 0;
+        held[c] = false;
+    }
+    root = -1;
+}
+
+int AdaptiveTuning::retune(int c)
+{
+    double new_correction = 0;
+    if (c != root)
+    {
+        int cents = (int) lround((pitch[c] - pitch[root]) * 100) % 1200;
+        new_correction = ji_correction[cents < 0 ? cents + 1200 : cents];
+    }
+    if (new_correction == correction[c]) return 0;
+    correction[c] = new_correction;
+    return 1 << c;
+}
+
+int AdaptiveTuning::retuneAll()
+{
+    int changed = 0;
+    for (int c = 0; c < 16; c++)
+    {
+        if (held[c]) changed |= retune(c);
+    }
+    return changed;
+}
+
+void AdaptiveTuning::chooseRoot()
+{
+    root = -1;
+    for (int c = 0; c < 16; c++)
+    {
+        if (held[c] && (root < 0 || pitch[c] < pitch[root])) root = c;
+    }
+}
+
+int AdaptiveTuning::noteOn(int channel, double note_pitch)
+{
+    int c = channel - 1;
+    bool replaced = held[c] || c == root;  // a new note on a channel whose note wasn't released
+    pitch[c] = note_pitch;
+    held[c] = true;
+
+    if (replaced)
+    {
+        chooseRoot();  // the root may have moved, or be this channel's old note
+        return retuneAll();
+    }
+    if (root < 0 || !held[root] || note_pitch < pitch[root])
+    {
+        root = c;
+        return retuneAll();
+    }
+    return retune(c);
+}
+
+int AdaptiveTuning::noteOff(int channel)
+{
+    int c = channel - 1;
+    held[c] = false;
+    if (c != root) return 0;
+
+    chooseRoot();
+    return root < 0 ? 0 : retuneAll();
+}
@@ -0,0 +1,46 @@
+/*
+  ==============================================================================
+
+    Adaptive just intonation for the notes currently held across MPE channels.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** Keeps held chords pure by nudging each note towards the just interval it makes
+    with the chord's lowest note. The lowest note stays on the static tuning, so
+    corrections never drift away from it, and each correction is limited to
+    adaptive_max_correction.
+
+    Updated incrementally on note-on and note-off: a note above the root only needs
+    its own interval looked up, and only a change of root (or a channel's note being
+    replaced without a note-off) revisits every held note, so an event costs at most
+    16 table lookups. Only used from the audio thread.
+*/
+class AdaptiveTuning {
+  public:
+    AdaptiveTuning();
+
+    void reset();
+
+    // pitch is the note's static retuned pitch in semitones; channel is 1-16.
+    // Both return a bit mask (bit 0 = channel 1) of channels whose correction changed.
+    int noteOn(int channel, double pitch);
+    int noteOff(int channel);
+
+    double correction[16];  // semitones to add to each channel's retuned pitch
+
+  private:
+    int retune(int c);
+    int retuneAll();
+    void chooseRoot();
+
+    double ji_correction[1200];  // for every static interval in cents, the step to the nearest just one
+    double pitch[16];
+    bool held[16];
+    int root = -1;
+};
+
+const double adaptive_max_correction = 0.25;  // semitones
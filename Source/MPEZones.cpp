@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    MPE zone layout and pitch bend ranges, tracked from incoming RPN messages.
+
+  ==============================================================================
+*/
+
+#include "MPEZones.h"
+#include "Tuning.h"
+
+// Controller numbers used by registered parameter messages.
+const int cc_data_entry_msb = 6;
+const int cc_data_entry_lsb = 38;
+const int cc_nrpn_lsb = 98;
+const int cc_nrpn_msb = 99;
+const int cc_rpn_lsb = 100;
+const int cc_rpn_msb = 101;
+
+const int rpn_null = 127;
+const int rpn_bend_range = 0;
+const int rpn_mpe_configuration = 6;
+
+MPEZones::MPEZones()
+{
+    reset();
+}
+
+void MPEZones::reset()
+{
+    // No zones until a configuration message arrives: every channel is retuned on its own and
+    // nothing is treated as a master channel, which keeps non-MPE keyboards working.
+    member_count[0] = 0;
+    member_count[1] = 0;
+    for (int zone = 0; zone < 2; zone++)
+    {
+        member_bend_range[zone] = default_member_bend_range;
+        master_bend_range[zone] = default_master_bend_range;
+    }
+    for (int channel = 0; channel < 16; channel++)
+    {
+        rpn_msb[channel] = rpn_null;
+        rpn_lsb[channel] = rpn_null;
+        data_msb[channel] = 0;
+    }
+}
+
+int MPEZones::zoneForChannel(int channel) const
+{
+    // Channels outside both zones are treated as part of the lower zone.
+    return (member_count[1] > 0 && channel >= 16 - member_count[1]) ? 1 : 0;
+}
+
+bool MPEZones::isMasterChannel(int channel) const
+{
+    return (channel == 1 && member_count[0] > 0) || (channel == 16 && member_count[1] > 0);
+}
+
+bool MPEZones::handleController(int channel, int controller, int value)
+{
+    int c = channel - 1;
+
+    switch (controller)
+    {
+        case cc_rpn_msb: rpn_msb[c] = value; return false;
+        case cc_rpn_lsb: rpn_lsb[c] = value; return false;
+        case cc_nrpn_msb:
+        case cc_nrpn_lsb: rpn_msb[c] = rpn_lsb[c] = rpn_null; return false;
+        default: break;
+    }
+
+    if (rpn_msb[c] != 0) return false;
+
+    if (controller == cc_data_entry_msb)
+    {
+        data_msb[c] = value;
+        if (rpn_lsb[c] == rpn_bend_range) return setBendRange(channel, value);
+        if (rpn_lsb[c] == rpn_mpe_configuration && (channel == 1 || channel == 16))
+        {
+            setMemberCount(channel == 1 ? 0 : 1, value);
+            return true;
+        }
+    }
+    else if (controller == cc_data_entry_lsb && rpn_lsb[c] == rpn_bend_range)
+    {
+        return setBendRange(channel, data_msb[c] + value / 100.0);  // LSB carries cents
+    }
+    return false;
+}
+
+void MPEZones::setMemberCount(int zone, int count)
+{
+    count = count < 0 ? 0 : (count > 15 ? 15 : count);
+    member_count[zone] = count;
+
+    // Zones may not overlap; the other zone gives up channels to make room.
+    int other = 1 - zone;
+    if (count + member_count[other] > 14) member_count[other] = count >= 14 ? 0 : 14 - count;
+
+    // A configuration message resets the zone's bend ranges to the MPE defaults.
+    member_bend_range[zone] = default_member_bend_range;
+    master_bend_range[zone] = default_master_bend_range;
+}
+
+bool MPEZones::setBendRange(int channel, double range)
+{
+    if (range <= 0) return false;
+
+    int zone = zoneForChannel(channel);
+    double& target = isMasterChannel(channel) ? master_bend_range[zone] : member_bend_range[zone];
+    if (target == range) return false;
+    target = range;
+    return true;
+}
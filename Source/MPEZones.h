@@ -0,0 +1,41 @@
+/*
+  ==============================================================================
+
+    MPE zone layout and pitch bend ranges, tracked from incoming RPN messages.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** Follows the MPE Configuration Message (RPN 6) and pitch bend sensitivity (RPN 0)
+    a controller sends on each channel. Only used from the audio thread.
+
+    Zone 0 is the lower zone (master channel 1, members from channel 2 up),
+    zone 1 the upper zone (master channel 16, members from channel 15 down).
+    Channels outside any zone behave like lower zone members.
+*/
+class MPEZones {
+  public:
+    MPEZones();
+
+    void reset();
+    int zoneForChannel(int channel) const;  // channel is 1-16
+    bool isMasterChannel(int channel) const;
+
+    // Feed every controller message through here; returns true if a zone's bend range changed.
+    bool handleController(int channel, int controller, int value);
+
+    int member_count[2];
+    double member_bend_range[2];
+    double master_bend_range[2];
+
+  private:
+    void setMemberCount(int zone, int count);
+    bool setBendRange(int channel, double range);
+
+    int rpn_msb[16];
+    int rpn_lsb[16];
+    int data_msb[16];
+};
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    Deadline-aware handling of dense MIDI bursts within one block.
+
+  ==============================================================================
+*/
+
+#include "OverloadGuard.h"
+
+OverloadGuard::OverloadGuard()
+{
+    for (int c = 0; c < 16; c++) coalesced_time[c] = -1;
+}
+
+void OverloadGuard::prepare(double sample_rate)
+{
+    seconds_per_sample = sample_rate > 0 ? 1 / sample_rate : 0;
+}
+
+void OverloadGuard::beginBlock(int num_samples, bool enable)
+{
+    enabled = enable && seconds_per_sample > 0;
+    is_overloaded = false;
+    event_count = 0;
+    shed_count = 0;
+    if (enabled)
+    {
+        auto budget = std::chrono::duration<double>(num_samples * seconds_per_sample * overload_budget);
+        deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(budget);
+    }
+}
+
+bool OverloadGuard::hold(int channel, bool is_member_bend, bool is_note, int pitchbend, int time, bool *flush)
+{
+    *flush = false;
+    if (!enabled) return false;
+    if (!is_overloaded && ++event_count % overload_check_interval == 0)
+    {
+        is_overloaded = std::chrono::steady_clock::now() > deadline;
+    }
+    if (!is_overloaded) return false;
+    
+    if (is_member_bend)
+    {
+        if (pending(channel)) shed_count++;
+        coalesced_bend[channel-1] = pitchbend;
+        coalesced_time[channel-1] = time;
+        return true;
+    }
+    *flush = is_note && pending(channel);  // the held bend belongs to the note before
+    return false;
+}
+
+int OverloadGuard::take(int channel, int *time)
+{
+    *time = coalesced_time[channel-1];
+    coalesced_time[channel-1] = -1;
+    return coalesced_bend[channel-1];
+}
@@ -0,0 +1,50 @@
+/*
+  ==============================================================================
+
+    Deadline-aware handling of dense MIDI bursts within one block.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <chrono>
+
+// Share of the block duration a block may spend before it starts coalescing bends, and
+// how many events go by between clock reads.
+const double overload_budget = 0.25;
+const int overload_check_interval = 16;
+
+//==============================================================================
+/** Watches how long the current block has taken. Once it has used overload_budget
+    of the block duration, pitch bends are held back instead of retuned: only the
+    last one per channel is kept, and sent when the channel's next note event comes
+    or the block ends. Notes are never held back. Only used from the audio thread.
+*/
+class OverloadGuard {
+  public:
+    OverloadGuard();
+
+    void prepare(double sample_rate);
+    void beginBlock(int num_samples, bool enabled);
+
+    // Call once per event, before handling it; channel is 1-16. Returns true if the event was
+    // a bend and has been held back. Otherwise the event is handled as usual, but if flush
+    // comes back true the channel's held bend has to be sent (take()) before it.
+    bool hold(int channel, bool is_member_bend, bool is_note, int pitchbend, int time, bool *flush);
+    bool isOverloaded() const { return is_overloaded; }
+    int shedCount() const { return shed_count; }  // held bends replaced by a later one, this block
+
+    bool pending(int channel) const { return coalesced_time[channel-1] >= 0; }
+    int take(int channel, int *time);
+
+  private:
+    double seconds_per_sample = 0;
+    std::chrono::steady_clock::time_point deadline;
+    bool enabled = false;
+    bool is_overloaded = false;
+    int event_count = 0;
+    int shed_count = 0;
+    int coalesced_bend[16];
+    int coalesced_time[16];
+};
@@ -0,0 +1,21 @@
+/*
+  ==============================================================================
+
+    Pitch CV for the audio outputs of the CV build.
+
+  ==============================================================================
+*/
+
+#include "PitchCV.h"
+
+float semitones_to_cv(double semitones)
+{
+  return (float) ((semitones - cv_zero_volt_note) / 12.0 / cv_volts_full_scale);
+}
+
+// No loop-carried dependency, so the compiler can vectorise it.
+void render_ramp(float *out, int num_samples, float start, float step)
+{
+  for (int i = 0; i < num_samples; ++i)
+    out[i] = start + step * (float) (i + 1);
+}
@@ -0,0 +1,22 @@
+/*
+  ==============================================================================
+
+    Pitch CV for the audio outputs of the CV build.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+// Pitch CV is scaled at 1V/oct, with full scale (1.0) on a DC-coupled interface taken as 10V
+// and middle C at 0V.
+const double cv_volts_full_scale = 10.0;
+const int cv_zero_volt_note = 60;
+const double cv_glide_seconds = 0.002;  // ramp between pitches, removes steps without audible glide
+const int cv_output_channels = 16;      // one per MIDI channel, on a discrete output layout
+
+// Sample value for a pitch in 12-ET semitones (MIDI note numbers).
+float semitones_to_cv(double semitones);
+
+// Fills out[0..num_samples) with start + step, start + 2 * step, ...
+void render_ramp(float *out, int num_samples, float start, float step);
@@ -11,7 +11,7 @@
 
 //==============================================================================
 NewProjectAudioProcessorEditor::NewProjectAudioProcessorEditor (NewProjectAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), visualizer (p), scaleEditor (p), audioProcessor (p)
 {
     
         addAndMakeVisible(fileNameLabel);      
@@ -28,44 +28,139 @@ NewProjectAudioProcessorEditor::NewProjectAudioProcessorEditor (NewProjectAudioP
         fileNameText.onTextChange = [this]
         {
             audioProcessor.path = fileNameText.getText().toStdString();
-            audioProcessor.error = this->audioProcessor.loadFile(audioProcessor.path);
-            if (audioProcessor.error)
-            {
-                audioProcessor.message = "Error loading file...reverting to 12-ET.";
-                errorText.setColour (juce::Label::textColourId, juce::Colours::orange);
-                errorText.setText (audioProcessor.message, juce::dontSendNotification);
-            }
-            else
-            {
-                string filename =  audioProcessor.path.substr(audioProcessor.path.find_last_of("/\\") + 1);
-                audioProcessor.message = "Sucessfully loaded: " + filename;
-                errorText.setColour (juce::Label::textColourId, juce::Colours::lightgreen);
-                errorText.setText (audioProcessor.message, juce::dontSendNotification);
-            }
+            loadFiles();
+        };
+        
+        addAndMakeVisible(keyboardMapLabel);
+        keyboardMapLabel.setText("Keyboard map:", juce::dontSendNotification);
+        keyboardMapLabel.setColour (juce::Label::textColourId, juce::Colours::white);
+        
+        // Keyboard Map Label Code (optional .kbm, empty for the default mapping)
+        addAndMakeVisible(keyboardMapText);
+        keyboardMapText.setEditable(true);
+        keyboardMapText.setText (audioProcessor.kbm_path, juce::dontSendNotification);
+        keyboardMapText.setColour (juce::Label::backgroundColourId, juce::Colours::white);
+        keyboardMapText.setColour(juce::Label::textWhenEditingColourId, juce::Colours::black);
+        keyboardMapText.setColour (juce::Label::textColourId, juce::Colours::black);
+        keyboardMapText.onTextChange = [this]
+        {
+            audioProcessor.kbm_path = keyboardMapText.getText().toStdString();
+            if (!audioProcessor.path.empty()) loadFiles();
         };
         
         // Error Label Code
         addAndMakeVisible(errorText);
-        if (audioProcessor.error)
+        updateStatus();
+        
+        // CV Output Code
+        addAndMakeVisible(cvOutputButton);
+        cvOutputButton.setButtonText("Pitch CV on audio outputs");
+        cvOutputButton.setToggleState (audioProcessor.cv_output, juce::dontSendNotification);
+        cvOutputButton.setVisible (audioProcessor.getTotalNumOutputChannels() > 0);  // a MIDI effect build has no audio outputs
+        cvOutputButton.onClick = [this]
+        {
+            audioProcessor.cv_output = cvOutputButton.getToggleState();
+        };
+        
+        // Adaptive Tuning Code
+        addAndMakeVisible(adaptiveButton);
+        adaptiveButton.setButtonText("Adaptive just intonation");
+        adaptiveButton.setToggleState (audioProcessor.adaptive_tuning, juce::dontSendNotification);
+        adaptiveButton.onClick = [this]
+        {
+            audioProcessor.adaptive_tuning = adaptiveButton.getToggleState();
+        };
+        
+        // Tuning Master Code
+        addAndMakeVisible(tuningMasterButton);
+        tuningMasterButton.setButtonText("Tuning master (share with other plugins)");
+        tuningMasterButton.setToggleState (audioProcessor.tuning_master, juce::dontSendNotification);
+        tuningMasterButton.onClick = [this]
+        {
+            audioProcessor.setTuningMaster(tuningMasterButton.getToggleState());
+            tuningMasterButton.setToggleState (audioProcessor.tuning_master, juce::dontSendNotification);  // another instance may be the master
+        };
+        
+        // Overload Protection Code
+        addAndMakeVisible(overloadButton);
+        overloadButton.setButtonText("Coalesce bends when overloaded");
+        overloadButton.setToggleState (audioProcessor.overload_protection, juce::dontSendNotification);
+        overloadButton.onClick = [this]
+        {
+            audioProcessor.overload_protection = overloadButton.getToggleState();
+        };
+        
+        // Bend Smoothing Code
+        addAndMakeVisible(smoothingButton);
+        smoothingButton.setButtonText("Smooth pitch bends");
+        smoothingButton.setToggleState (audioProcessor.bend_smoothing, juce::dontSendNotification);
+        smoothingButton.onClick = [this]
+        {
+            audioProcessor.bend_smoothing = smoothingButton.getToggleState();
+        };
+        addAndMakeVisible(slewRateSlider);
+        slewRateSlider.setSliderStyle (juce::Slider::LinearHorizontal);
+        slewRateSlider.setTextBoxStyle (juce::Slider::TextBoxRight, false, 60, 20);
+        slewRateSlider.setRange (10, 2000, 1);
+        slewRateSlider.setSkewFactorFromMidPoint (200);
+        slewRateSlider.setTextValueSuffix (" st/s");
+        slewRateSlider.setValue (audioProcessor.bend_slew_rate, juce::dontSendNotification);
+        slewRateSlider.onValueChange = [this]
         {
-            errorText.setColour (juce::Label::textColourId, juce::Colours::orange);
-            errorText.setText (audioProcessor.message, juce::dontSendNotification);
-        }
-        else
+            audioProcessor.bend_slew_rate = (float) slewRateSlider.getValue();
+        };
+        
+        // Visualizer Code
+        addAndMakeVisible(visualizer);
+        visualizer.setPitchClasses(audioProcessor.pitchClasses());
+        
+        // Scale Editor Code
+        addAndMakeVisible(scaleEditor);
+        scaleEditor.onEdit = [this]
         {
-            errorText.setColour (juce::Label::textColourId, juce::Colours::lightgreen);
-            errorText.setText (audioProcessor.message, juce::dontSendNotification);
-        }
+            visualizer.setPitchClasses(audioProcessor.pitchClasses());
+        };
         
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (400, 300);
+    setSize (400, 530);
 }
 
 NewProjectAudioProcessorEditor::~NewProjectAudioProcessorEditor()
 {
 }
 
+void NewProjectAudioProcessorEditor::loadFiles()
+{
+    audioProcessor.loadFilesAsync();
+    updateStatus();
+}
+
+// Called by the processor on the message thread once a load has finished.
+void NewProjectAudioProcessorEditor::tuningLoaded()
+{
+    updateStatus();
+    visualizer.setPitchClasses(audioProcessor.pitchClasses());
+    scaleEditor.refresh();
+}
+
+void NewProjectAudioProcessorEditor::updateStatus()
+{
+    if (audioProcessor.loading)
+    {
+        errorText.setColour (juce::Label::textColourId, juce::Colours::white);
+    }
+    else if (audioProcessor.error)
+    {
+        errorText.setColour (juce::Label::textColourId, juce::Colours::orange);
+    }
+    else
+    {
+        errorText.setColour (juce::Label::textColourId, juce::Colours::lightgreen);
+    }
+    errorText.setText (audioProcessor.message, juce::dontSendNotification);
+}
+
 //==============================================================================
 void NewProjectAudioProcessorEditor::paint (juce::Graphics& g)
 {
@@ -81,5 +176,15 @@ void NewProjectAudioProcessorEditor::resized()
         int height = getHeight();
         fileNameLabel.setBounds (30, 50, width - 150, 20);
         fileNameText.setBounds (100, 50, width - 150, 20);
-        errorText.setBounds (100, 80, width - 150, 20);
+        keyboardMapLabel.setBounds (10, 80, 90, 20);
+        keyboardMapText.setBounds (100, 80, width - 150, 20);
+        errorText.setBounds (100, 110, width - 150, 20);
+        cvOutputButton.setBounds (96, 140, width - 150, 24);
+        adaptiveButton.setBounds (96, 165, width - 150, 24);
+        tuningMasterButton.setBounds (96, 190, width - 110, 24);
+        overloadButton.setBounds (96, 215, width - 110, 24);
+        smoothingButton.setBounds (96, 240, 140, 24);
+        slewRateSlider.setBounds (236, 240, width - 256, 24);
+        visualizer.setBounds (30, 275, width - 60, height - 380);
+        scaleEditor.setBounds (30, height - 90, width - 60, 70);
 }
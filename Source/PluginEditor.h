@@ -10,6 +10,8 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "TuningVisualizer.h"
+#include "ScaleEditor.h"
 
 //==============================================================================
 /**
@@ -23,12 +25,26 @@ public:
     //==============================================================================
     void paint (juce::Graphics&) override;
     void resized() override;
+    void tuningLoaded();
     //==============================================================================
     juce::Label fileNameLabel;
     juce::Label fileNameText;
+    juce::Label keyboardMapLabel;
+    juce::Label keyboardMapText;
     juce::Label errorText;
+    juce::ToggleButton cvOutputButton;
+    juce::ToggleButton adaptiveButton;
+    juce::ToggleButton tuningMasterButton;
+    juce::ToggleButton overloadButton;
+    juce::ToggleButton smoothingButton;
+    juce::Slider slewRateSlider;
+    TuningVisualizer visualizer;
+    ScaleEditor scaleEditor;
 
 private:
+    void loadFiles();
+    void updateStatus();
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     NewProjectAudioProcessor& audioProcessor;
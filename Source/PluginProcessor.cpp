@@ -15,145 +15,321 @@
 #include <math.h>
 using namespace std;
 
-int isComment(string str)
+// Rough size of a short event in MidiBuffer's storage, its time and size fields included.
+const size_t midi_event_size_estimate = 12;
+
+// Bend smoothing works in steps of about a millisecond, and never adds more than this many
+// pitch wheel events to one block.  Past that the glides pause until the next block.
+const double slew_tick_target_seconds = 0.001;
+const int slew_max_events = 256;
+
+// Each queued SysEx message is preceded by its size, little-endian.
+const int sysex_size_bytes = 4;
+
+// Everything but notes and pitch wheel leaves processBlock() exactly as it came in.
+bool passes_through(const juce::uint8 *data, int size)
+{
+  if (size < 1) return false;
+  int status = data[0] & 0xF0;
+  return status != 0x80 && status != 0x90 && status != 0xE0;
+}
+
+// Moves every channel's bend towards its target by at most max_step.  No branches across
+// channels, so the compiler can vectorise it.
+void slew_step(float *current, const float *target, const float *max_step)
+{
+  for (int c = 0; c < 16; ++c)
+  {
+    float delta = target[c] - current[c];
+    delta = delta > max_step[c] ? max_step[c] : delta;
+    delta = delta < -max_step[c] ? -max_step[c] : delta;
+    current[c] += delta;
+  }
+}
+
+
+//==============================================================================
+NewProjectAudioProcessor::NewProjectAudioProcessor()
+#ifndef JucePlugin_PreferredChannelConfigurations
+     : AudioProcessor (BusesProperties()
+                     #if ! JucePlugin_IsMidiEffect
+                      #if ! JucePlugin_IsSynth
+                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                      #endif
+                       .withOutput ("CV", juce::AudioChannelSet::discreteChannels (cv_output_channels), true)
+                     #endif
+                       )
+#endif
+{
+    state = juce::ValueTree ("ScalaMPE");
+}
+
+NewProjectAudioProcessor::~NewProjectAudioProcessor()
 {
-  return str.length() && str.at(0) == '!';
+    loader.removeAllJobs(true, 5000);
+    sysex_parser.removeAllJobs(true, 5000);
+    cancelPendingUpdate();
+    shared_tuning.close();
 }
 
-double interpretValue(string str)
+//==============================================================================
+int NewProjectAudioProcessor::loadFile(string filename, string kbm_filename)
 {
-    if (str.find('.') != string::npos)
+    unique_ptr<Tuning> tuning(new Tuning());
+    vector<string> text;
+    ifstream myfile(filename);
+    int has_error = interpretFile(&tuning->scale, &myfile, &text);
+    myfile.close();
+    
+    if (has_error || tuning->scale.count < 1)
     {
-        return stof(str) / 100;
+        publishTuning(nullptr, {}, true);  // revert to 12-ET
+        return 1;
     }
-    else
+    
+    if (!kbm_filename.empty())
     {
-      int pos = str.find("/");
-      if (pos != string::npos)
-      {
-        string num = str.substr(0, pos);
-        string den = str.substr(pos+1, str.length() - pos);
-	    return 12.0 * log2(stof(num) / stof(den));
-      }
-      else
-      {
-	    return 12.0 * log2(stof(str));
-      }
+        ifstream kbmfile(kbm_filename);
+        tuning->has_keyboard = true;
+        has_error = interpretKeyboardFile(&tuning->keyboard, &kbmfile);
+        kbmfile.close();
+        
+        if (has_error)
+        {
+            publishTuning(nullptr, {}, true);
+            return 2;  // return 2 if the keyboard mapping is at fault
+        }
     }
+    
+    double ranges[2] = { bend_range[0], bend_range[1] };
+    compile_tuning(tuning.get(), ranges);
+    publishTuning(std::move(tuning), std::move(text), true);
+    return 0;
 }
 
-int interpretLine(Scale *scale, string line, int line_num)
+// A newly loaded tuning replaces the scale text, and any edits made to the previous one.
+// from_path is false for a tuning received over SysEx, which path can't bring back.
+void NewProjectAudioProcessor::publishTuning (unique_ptr<Tuning> tuning, vector<string> text, bool from_path)
 {
-  if (line_num == 0)
-  {
-    scale->description = line;
-  }
-  else if (line_num == 1)
-  {
-    scale->count = stoi(line);
-  }
-  else
-  {
-    if (scale->i+1 < scale->count)
+    lock_guard<mutex> lock(scale_text_lock);
+    tunings.publish(std::move(tuning));
+    degree_text = std::move(text);
+    degree_edits.clear();
+    scale_from_path = from_path;
+}
+
+// File I/O and parsing stay off the message thread, which may be stuck on a slow drive.
+// The result is picked up by handleAsyncUpdate().
+void NewProjectAudioProcessor::loadFilesAsync()
+{
+    string filename = path;
+    string kbm_filename = kbm_path;
+    
+    loading = true;
+    message = "Loading " + filename.substr(filename.find_last_of("/\\") + 1) + "...";
+    
+    loader.removeAllJobs(false, 0);  // a newer request supersedes any that haven't started
+    loader.addJob([this, filename, kbm_filename]
+    {
+        load_error = loadFile(filename, kbm_filename);
+        if (tuning_master) shareTuning();
+        load_finished = true;
+        triggerAsyncUpdate();
+    });
+}
+
+void NewProjectAudioProcessor::loadFinished()
+{
+    loading = false;
+    error = load_error;
+    if (error)
     {
-      scale->scale_array[++scale->i] = interpretValue(line);
+        message = error == 2 ? "Error loading keyboard map...reverting to 12-ET."
+                             : "Error loading file...reverting to 12-ET.";
     }
-    else if (scale->i+1 == scale->count)
+    else
     {
-        scale->scale_array[0] = interpretValue(line) - 12;
+        string filename =  path.substr(path.find_last_of("/\\") + 1);
+        message = "Sucessfully loaded: " + filename;
     }
-  }
-    return 0;
+    
+    NewProjectAudioProcessorEditor *editor =
+        dynamic_cast<NewProjectAudioProcessorEditor*>(getActiveEditor());
+    if (editor != NULL) editor->tuningLoaded();
 }
 
-int interpretFile(Scale *scale, ifstream *file)
+// SysEx parser thread: parses every queued tuning SysEx and publishes it like a loaded file.
+// The last valid one wins.
+void NewProjectAudioProcessor::loadSysEx()
 {
-  string line;
-  int line_num = 0;
-  if (file->good())
-  {
-    bool has_error = true;
-    while (getline(*file, line))
-    {
-      has_error = false;
-      if (!isComment(line))
-      {
-	    interpretLine(scale, line, line_num);
-        line_num++;
-      }
+    vector<uint8_t> data;
+    bool loaded = false;
+    while (sysex_fifo.getNumReady() >= sysex_size_bytes)
+    {
+        int start1, size1, start2, size2;
+        sysex_fifo.prepareToRead(sysex_fifo.getNumReady(), start1, size1, start2, size2);
+        auto byte = [&] (int n) { return sysex_bytes[n < size1 ? start1 + n : start2 + n - size1]; };
+        
+        int size = 0;
+        for (int i = 0; i < sysex_size_bytes; i++) size |= byte(i) << (8 * i);
+        data.resize(size);
+        for (int i = 0; i < size; i++) data[i] = byte(sysex_size_bytes + i);
+        sysex_fifo.finishedRead(sysex_size_bytes + size);
+        
+        unique_ptr<Tuning> tuning(new Tuning());
+        vector<string> text;
+        int has_error = 1;
+        tunings.read([&] (const Tuning *current)
+        {
+            has_error = interpret_tuning_sysex(data.data(), size, current, tuning.get(), &text);
+        });
+        if (has_error) continue;
+        
+        double ranges[2] = { bend_range[0], bend_range[1] };
+        compile_tuning(tuning.get(), ranges);
+        publishTuning(std::move(tuning), std::move(text), false);
+        loaded = true;
     }
-    cout << "\n";
-    return has_error; // return 1 if error
-  }
-
-  else
-  {
-    cout << "Unable to open file\n";
-    return 1;
-  }
+    if (!loaded) return;
+    
+    if (tuning_master) shareTuning();
+    sysex_loaded = true;
+    triggerAsyncUpdate();
 }
 
-double scale_value(double value, double dmin, double dmax, double cmin, double cmax)
+void NewProjectAudioProcessor::sysExLoaded()
 {
-  double drange = (dmax - dmin);
-  double crange = (cmax - cmin);
-  return (((value - dmin) * crange) / drange) + cmin;
+    string description;
+    tunings.read([&description] (const Tuning *tuning) { if (tuning != nullptr) description = tuning->scale.description; });
+    error = 0;
+    message = "Received over SysEx: " + description;
+    
+    NewProjectAudioProcessorEditor *editor =
+        dynamic_cast<NewProjectAudioProcessorEditor*>(getActiveEditor());
+    if (editor != NULL) editor->tuningLoaded();
 }
 
-double semitones_to_pitchbend(double value)
+// Only one instance at a time, in any process, can be the master; tuning_master stays
+// false if another one already is.
+void NewProjectAudioProcessor::setTuningMaster (bool enabled)
 {
-  return value * (512/3);
+    bool opened = enabled && shared_tuning.open();
+    if (!opened) shared_tuning.close();
+    tuning_master = opened;
+    if (opened) shareTuning();
 }
 
-double pitchbend_to_semitones(double value)
+// Without a loaded scale the shared table is 12-ET, like the MIDI output.
+void NewProjectAudioProcessor::shareTuning()
 {
-  return value / (512/3);
+    double frequency[128];
+    tunings.read([&frequency] (const Tuning *tuning)
+    {
+        for (int note = 0; note < 128; note++)
+        {
+            double pitch = tuning != nullptr ? tuning->note_pitch[note] : note;
+            bool mapped = tuning == nullptr || tuning->note_mapped[note];
+            frequency[note] = mapped ? 440 * pow(2.0, (pitch - 69) / 12) : 0;
+        }
+    });
+    shared_tuning.write(frequency);
 }
 
-double midi_note_scala(Scale *scale, int midi_note)
+int NewProjectAudioProcessor::getDegreeCount()
 {
-  return scale->scale_array[midi_note % scale->count] + (floor(midi_note / scale->count) * 12);
+    int count = 0;
+    tunings.read([&count] (const Tuning *tuning) { if (tuning != nullptr) count = tuning->scale.count; });
+    return count;
 }
 
-double new_pitchbend(Scale *scale, int midi_note, int pitchbend)
+double NewProjectAudioProcessor::getDegreeCents (int degree)
 {
-  double midi_note_f = midi_note + pitchbend_to_semitones(pitchbend - 8192);
-  double new_midi_note_f = scale_value(midi_note_f,
-                                       floor(midi_note_f),
-                                       ceil(midi_note_f + .001),
-                                       midi_note_scala(scale, floor(midi_note_f)),
-                                       midi_note_scala(scale, ceil(midi_note_f + .001)));
-  return semitones_to_pitchbend(new_midi_note_f - midi_note) + 8192;
+    double cents = 0;
+    tunings.read([&cents, degree] (const Tuning *tuning)
+    {
+        if (tuning == nullptr || degree < 1 || degree > tuning->scale.count) return;
+        int index = scale_index(&tuning->scale, degree);
+        cents = (index == 0 ? tuning->scale.scale_array[0] + 12 : tuning->scale.scale_array[index]) * 100;
+    });
+    return cents;
 }
 
+string NewProjectAudioProcessor::getDegreeText (int degree)
+{
+    lock_guard<mutex> lock(scale_text_lock);
+    string text;
+    tunings.read([this, &text, degree] (const Tuning *tuning)
+    {
+        if (tuning == nullptr || degree < 1 || degree > tuning->scale.count) return;
+        text = degree_text[scale_index(&tuning->scale, degree)];
+    });
+    return text;
+}
 
-//==============================================================================
-NewProjectAudioProcessor::NewProjectAudioProcessor()
-#ifndef JucePlugin_PreferredChannelConfigurations
-     : AudioProcessor (BusesProperties()
-                     #if ! JucePlugin_IsMidiEffect
-                      #if ! JucePlugin_IsSynth
-                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
-                      #endif
-                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
-                     #endif
-                       )
-#endif
+// Only the keys that play the edited degree are recompiled, then the whole tuning is swapped
+// in for the audio thread as usual.
+bool NewProjectAudioProcessor::setDegree (int degree, string value)
 {
-    state = juce::ValueTree ("ScalaMPE");
+    double semitones;
+    try
+    {
+        semitones = interpretValue(value);
+    }
+    catch (const exception&)
+    {
+        return false;
+    }
+    if (!isfinite(semitones)) return false;
+    
+    lock_guard<mutex> lock(scale_text_lock);
+    int index = 0;
+    bool changed = tunings.update([degree, semitones, &index] (Tuning& tuning)
+    {
+        if (degree < 1 || degree > tuning.scale.count) return false;
+        index = scale_index(&tuning.scale, degree);
+        tuning.scale.scale_array[index] = index == 0 ? semitones - 12 : semitones;
+        compile_degree(&tuning, index);
+        return true;
+    });
+    if (!changed) return false;
+    
+    degree_text[index] = value;
+    if (scale_from_path) degree_edits[degree] = value;  // saved edits are applied to path's scale
+    if (tuning_master) shareTuning();
+    return changed;
 }
 
-NewProjectAudioProcessor::~NewProjectAudioProcessor()
+int NewProjectAudioProcessor::exportScale (string filename)
 {
+    lock_guard<mutex> lock(scale_text_lock);
+    int has_error = 1;
+    tunings.read([this, &has_error, filename] (const Tuning *tuning)
+    {
+        if (tuning == nullptr) return;
+        ofstream myfile(filename);
+        has_error = writeFile(&tuning->scale, degree_text, &myfile);
+        myfile.close();
+    });
+    return has_error;
 }
 
-//==============================================================================
-int NewProjectAudioProcessor::loadFile(string filename)
+vector<double> NewProjectAudioProcessor::pitchClasses()
 {
-    ifstream myfile(filename);
-    loaded = !interpretFile(&scale, &myfile);  // file was loaded if there is no error
-    myfile.close();
-    return !loaded;  // return 1 if error;
+    vector<double> pitch_classes;
+    tunings.read([&pitch_classes] (const Tuning *tuning)
+    {
+        if (tuning == nullptr) return;
+        for (int note = 0; note < 128; note++)
+        {
+            if (!tuning->note_mapped[note]) continue;
+            double pitch_class = fmod(tuning->note_pitch[note], 12.0);
+            if (pitch_class < 0) pitch_class += 12;
+            bool seen = false;
+            for (double p : pitch_classes) seen = seen || fabs(p - pitch_class) < 0.001;
+            if (!seen) pitch_classes.push_back(pitch_class);
+        }
+    });
+    return pitch_classes;
 }
 
 const juce::String NewProjectAudioProcessor::getName() const
@@ -222,6 +398,16 @@ void NewProjectAudioProcessor::prepareToPlay (double sampleRate, int samplesPerB
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
+    cv_ramp_samples = juce::jmax(1, juce::roundToInt(sampleRate * cv_glide_seconds));
+    overload.prepare(sampleRate);
+    slew_interval_samples = juce::jmax(1, juce::roundToInt(sampleRate * slew_tick_target_seconds));
+    slew_tick_seconds = slew_interval_samples / sampleRate;
+    slew_next_tick = 0;
+    for (int channel = 0; channel < 16; channel++)
+    {
+        cv_current[channel] = cv_target[channel];
+        cv_ramp_remaining[channel] = 0;
+    }
 }
 
 void NewProjectAudioProcessor::releaseResources()
@@ -241,6 +427,9 @@ bool NewProjectAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
     // In this template code we only support mono or stereo.
     // Some plugin hosts, such as certain GarageBand versions, will only
     // load plugins that support stereo bus layouts.
+    // Sixteen discrete outputs carry pitch CV for every MIDI channel; the input doesn't matter then.
+    if (layouts.getMainOutputChannelSet() == juce::AudioChannelSet::discreteChannels (cv_output_channels))
+        return true;
     if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
      && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
         return false;
@@ -256,27 +445,318 @@ bool NewProjectAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
 }
 #endif
 
+void NewProjectAudioProcessor::setCVTarget (int channel, double semitones)
+{
+    cv_target[channel] = semitones_to_cv(semitones);
+    cv_step[channel] = (cv_target[channel] - cv_current[channel]) / cv_ramp_samples;
+    cv_ramp_remaining[channel] = cv_ramp_samples;
+}
+
+// Renders samples [start, end) of every channel's CV.  Output channel n carries MIDI channel n+1.
+void NewProjectAudioProcessor::renderCV (juce::AudioBuffer<float>& buffer, int start, int end)
+{
+    if (end <= start) return;
+    
+    int num_channels = juce::jmin(cv_output_channels, buffer.getNumChannels());
+    for (int channel = 0; channel < num_channels; channel++)
+    {
+        float *out = buffer.getWritePointer(channel, start);
+        int num_samples = end - start;
+        int ramp_samples = juce::jmin(num_samples, cv_ramp_remaining[channel]);
+        
+        render_ramp(out, ramp_samples, cv_current[channel], cv_step[channel]);
+        cv_ramp_remaining[channel] -= ramp_samples;
+        cv_current[channel] = cv_ramp_remaining[channel] ? cv_current[channel] + cv_step[channel] * ramp_samples
+                                                       : cv_target[channel];
+        juce::FloatVectorOperations::fill(out + ramp_samples, cv_current[channel], num_samples - ramp_samples);
+    }
+}
+
+// Takes tuning SysEx out of the stream and queues it for the SysEx parser thread, without
+// allocating. Returns false for every other message.
+bool NewProjectAudioProcessor::receiveSysEx (const juce::MidiMessageMetadata& metadata)
+{
+    if (!is_tuning_sysex(metadata.data, metadata.numBytes)) return false;
+    
+    int size = metadata.numBytes;
+    if (sysex_fifo.getFreeSpace() < sysex_size_bytes + size) return true;  // parser has fallen behind, drop it
+    
+    int start1, size1, start2, size2;
+    sysex_fifo.prepareToWrite(sysex_size_bytes + size, start1, size1, start2, size2);
+    auto byte = [&] (int n) -> uint8_t& { return sysex_bytes[n < size1 ? start1 + n : start2 + n - size1]; };
+    for (int i = 0; i < sysex_size_bytes; i++) byte(i) = (uint8_t) (size >> (8 * i));
+    for (int i = 0; i < size; i++) byte(sysex_size_bytes + i) = metadata.data[i];
+    sysex_fifo.finishedWrite(size1 + size2);
+    
+    triggerAsyncUpdate();
+    return true;
+}
+
+// Follows RPN bend range and MPE configuration messages, and asks for the affected
+// retuning tables to be rebuilt on the message thread.
+void NewProjectAudioProcessor::trackZones (const juce::uint8* data, int size)
+{
+    if (size != 3 || (data[0] & 0xF0) != 0xB0) return;
+    
+    if (zones.handleController((data[0] & 0x0F) + 1, data[1], data[2]))
+    {
+        bend_range[0] = zones.member_bend_range[0];
+        bend_range[1] = zones.member_bend_range[1];
+        triggerAsyncUpdate();
+    }
+}
+
+void NewProjectAudioProcessor::handleAsyncUpdate()
+{
+    if (load_finished.exchange(false)) loadFinished();
+    if (sysex_loaded.exchange(false)) sysExLoaded();
+    if (sysex_fifo.getNumReady() > 0) sysex_parser.addJob([this] { loadSysEx(); });
+    
+    tunings.update([this] (Tuning& tuning)
+    {
+        bool changed = false;
+        for (int zone = 0; zone < 2; zone++)
+        {
+            if (tuning.bend_range[zone] != bend_range[zone])
+            {
+                tuning.bend_range[zone] = bend_range[zone];
+                compile_zone(&tuning, zone);
+                changed = true;
+            }
+        }
+        return changed;
+    });
+}
+
+// Sends the retuned pitch wheel for a channel's note, combining its own bend with the zone's
+// master bend.
+void NewProjectAudioProcessor::emitBend (const Tuning* tuning, int channel, int time, juce::MidiBuffer& out)
+{
+    int c = channel - 1;
+    int zone = zones.zoneForChannel(channel);
+    int updated_pitchbend = new_pitchbend(tuning, zone, midi_note[c], member_bend[c], master_bend[zone]);
+    if (adaptive_active)
+    {
+        updated_pitchbend = clamp_pitchbend(updated_pitchbend + semitones_to_pitchbend(adaptive.correction[c], tuning->bend_range[zone]));
+        adaptive_pending &= ~(1 << c);
+    }
+    
+    out.addEvent(juce::MidiMessage::pitchWheel(channel, updated_pitchbend), time);
+    channel_pitch[c] = midi_note[c] + pitchbend_to_semitones(updated_pitchbend - 8192, tuning->bend_range[zone]);
+    if (render_cv) setCVTarget(c, channel_pitch[c]);
+}
+
+// A master bend moves every note in its zone.  It is not passed on; instead each member channel
+// gets a new retuned bend, once for a whole run of consecutive master bends.
+void NewProjectAudioProcessor::flushMasterBend (const Tuning* tuning, int zone, juce::MidiBuffer& out)
+{
+    int time = master_bend_time[zone];
+    master_bend_time[zone] = -1;
+    
+    for (int channel = 1; channel <= 16; channel++)
+    {
+        if (!channel_has_note[channel-1] || zones.isMasterChannel(channel) || zones.zoneForChannel(channel) != zone) continue;
+        
+        emitBend(tuning, channel, time, out);
+    }
+}
+
+void NewProjectAudioProcessor::flushCoalescedBend (const Tuning* tuning, int channel, juce::MidiBuffer& out)
+{
+    int time;
+    member_bend[channel-1] = overload.take(channel, &time);
+    emitBend(tuning, channel, time, out);
+}
+
+// Sends each channel's bend one tick further towards its target.  Returns the number of events added.
+int NewProjectAudioProcessor::slewTick (int time, const float* max_step, juce::MidiBuffer& out)
+{
+    slew_step(slew_current, slew_target, max_step);
+    
+    int events = 0;
+    for (int c = 0; c < 16; c++)
+    {
+        int value = (int) lround(slew_current[c]);
+        if (slew_sent[c] < 0 || value == slew_sent[c]) continue;
+        out.addEvent(juce::MidiMessage::pitchWheel(c + 1, value), time);
+        slew_sent[c] = value;
+        events++;
+    }
+    return events;
+}
+
+// Output stage: pitch wheel events become targets that each channel's bend slews towards.
+// Works on the raw bytes of the finished output; everything else is copied as it is.
+void NewProjectAudioProcessor::smoothBends (const Tuning* tuning, juce::MidiBuffer& midi, int num_samples)
+{
+    juce::MidiBuffer smoothed;
+    float max_step[16];
+    for (int c = 0; c < 16; c++)
+    {
+        double range = tuning->bend_range[zones.zoneForChannel(c + 1)];
+        max_step[c] = (float) semitones_to_pitchbend(bend_slew_rate * slew_tick_seconds, range);
+    }
+    
+    int events = 0;
+    auto tickUntil = [&] (int time)
+    {
+        for (; slew_next_tick <= time; slew_next_tick += slew_interval_samples)
+        {
+            if (events < slew_max_events) events += slewTick(slew_next_tick, max_step, smoothed);
+        }
+    };
+    
+    for (const auto metadata : midi)
+    {
+        const juce::uint8 *data = metadata.data;
+        const int time = metadata.samplePosition;
+        const int c = data[0] & 0x0F;
+        tickUntil(time);
+        
+        if (metadata.numBytes == 3 && (data[0] & 0xF0) == 0xE0)
+        {
+            int value = data[1] | (data[2] << 7);
+            slew_target[c] = (float) value;
+            if (slew_sent[c] >= 0) continue;
+            
+            slew_current[c] = (float) value;  // nothing sent on this channel yet to glide from
+            slew_sent[c] = value;
+        }
+        else if (metadata.numBytes == 3 && (data[0] & 0xF0) == 0x90 && data[2] > 0
+                 && slew_sent[c] >= 0 && (int) lround(slew_current[c]) != (int) slew_target[c])
+        {
+            // A new note starts at its own pitch rather than gliding from the last one.
+            slew_current[c] = slew_target[c];
+            slew_sent[c] = (int) slew_target[c];
+            smoothed.addEvent(juce::MidiMessage::pitchWheel(c + 1, slew_sent[c]), time);
+        }
+        smoothed.addEvent(data, metadata.numBytes, time);
+    }
+    tickUntil(num_samples - 1);
+    slew_next_tick -= num_samples;
+    midi.swapWith(smoothed);
+}
+
+// Corrections to notes other than the one that triggered them go out once per block, at the
+// time of the last change, so a burst of note events can't multiply the bends sent.
+void NewProjectAudioProcessor::flushAdaptive (const Tuning* tuning, juce::MidiBuffer& out)
+{
+    for (int channel = 1; channel <= 16 && adaptive_pending != 0; channel++)
+    {
+        if (!(adaptive_pending & (1 << (channel-1)))) continue;
+        
+        emitBend(tuning, channel, adaptive_time, out);
+    }
+}
+
 void NewProjectAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     buffer.clear();
     juce::MidiBuffer processedMidi;
+    TuningExchange::ScopedRead read(tunings);
+    const Tuning *tuning = read.tuning;
                 
-    if (!loaded) return;  // Do nothing if file was note loaded.
+    if (tuning == nullptr)  // Do nothing if file was not loaded, but keep following the controller setup.
+    {
+        bool received = false;
+        for (const auto metadata : midiMessages)
+        {
+            if (receiveSysEx(metadata)) received = true;
+            else trackZones(metadata.data, metadata.numBytes);
+        }
+        if (received)  // a tuning meant for us shouldn't retune the synth as well
+        {
+            for (const auto metadata : midiMessages)
+                if (!is_tuning_sysex(metadata.data, metadata.numBytes)) processedMidi.addEvent(metadata.data, metadata.numBytes, metadata.samplePosition);
+            midiMessages.swapWith(processedMidi);
+        }
+        for (int channel = 0; channel < 16; channel++) live_active[channel] = false;
+        return;
+    }
+    
+    render_cv = cv_output && buffer.getNumChannels() > 0;
+    if (adaptive_active != adaptive_tuning)
+    {
+        adaptive.reset();
+        adaptive_pending = 0;
+        adaptive_active = adaptive_tuning;
+    }
+    if (smoothing_active != bend_smoothing)
+    {
+        for (int channel = 0; channel < 16; channel++) slew_sent[channel] = -1;
+        smoothing_active = bend_smoothing;
+    }
+    int rendered = 0;
+    processedMidi.ensureSize((size_t) midiMessages.getNumEvents() * 2 * midi_event_size_estimate);  // room for a bend per event
+    
+    overload.beginBlock(buffer.getNumSamples(), overload_protection);
     
     for (const auto metadata : midiMessages)
     {
+        if (receiveSysEx(metadata)) continue;  // before getMessage(), which would copy it to the heap
+        
+        if (passes_through(metadata.data, metadata.numBytes))  // copied on its raw bytes, never decoded
+        {
+            trackZones(metadata.data, metadata.numBytes);
+            processedMidi.addEvent(metadata.data, metadata.numBytes, metadata.samplePosition);
+            continue;
+        }
+        
         auto message = metadata.getMessage();
         const auto time = metadata.samplePosition;
+        
+        const bool is_member_bend = message.isPitchWheel() && !zones.isMasterChannel(message.getChannel());
+        bool flush_held;
+        if (overload.hold(message.getChannel(), is_member_bend, message.isNoteOn() || message.isNoteOff(),
+                          is_member_bend ? message.getPitchWheelValue() : 0, time, &flush_held))
+        {
+            continue;
+        }
+        if (flush_held) flushCoalescedBend(tuning, message.getChannel(), processedMidi);
+        
+        if (render_cv)
+        {
+            int until = juce::jlimit(rendered, buffer.getNumSamples(), time);
+            renderCV(buffer, rendered, until);
+            rendered = until;
+        }
+        
+        if (message.isPitchWheel() && zones.isMasterChannel(message.getChannel()))
+        {
+            int zone = zones.zoneForChannel(message.getChannel());
+            master_bend[zone] = pitchbend_to_semitones(message.getPitchWheelValue() - 8192, zones.master_bend_range[zone]);
+            master_bend_time[zone] = time;
+            continue;
+        }
+        for (int zone = 0; zone < 2; zone++)
+        {
+            if (master_bend_time[zone] >= 0) flushMasterBend(tuning, zone, processedMidi);
+        }
  
-        if (message.isNoteOn())
+        if (message.isNoteOn() && !tuning->note_mapped[message.getNoteNumber()])
+        {
+            continue;  // key left unmapped by the keyboard mapping
+        }
+        else if (message.isNoteOn() && zones.isMasterChannel(message.getChannel()))
+        {
+            processedMidi.addEvent(metadata.data, metadata.numBytes, time);  // retuning the master channel would bend the whole zone
+        }
+        else if (message.isNoteOn())
         {
             message = juce::MidiMessage::noteOn (message.getChannel(),
                                                  message.getNoteNumber(),
                                                  message.getVelocity());
             midi_note[message.getChannel()-1] = message.getNoteNumber();
-            double updated_pitchbend = new_pitchbend(&scale, midi_note[message.getChannel()-1], 8192);
-            processedMidi.addEvent (juce::MidiMessage::pitchWheel(message.getChannel(), updated_pitchbend), time);
-            processedMidi.addEvent (message, time);
+            member_bend[message.getChannel()-1] = 8192;
+            channel_has_note[message.getChannel()-1] = true;
+            channel_active[message.getChannel()-1] = true;
+            if (adaptive_active)
+            {
+                adaptive_pending |= adaptive.noteOn(message.getChannel(), tuning->note_pitch[message.getNoteNumber()]);
+                adaptive_time = time;
+            }
+            emitBend(tuning, message.getChannel(), time, processedMidi);
+            processedMidi.addEvent(message, time);
         }
         else if (message.isNoteOff())
         {
@@ -284,20 +764,42 @@ void NewProjectAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
                                                   message.getNoteNumber(),
                                                   message.getVelocity());
             processedMidi.addEvent(message, time);
+            channel_active[message.getChannel()-1] = false;
+            if (adaptive_active && !zones.isMasterChannel(message.getChannel()))
+            {
+                adaptive_pending |= adaptive.noteOff(message.getChannel());
+                adaptive_time = time;
+            }
         }
         else if (message.isPitchWheel()) // 0 - 16384 (Roli has range of 4 octaves), 8192 is neutral
         {
-            double pitchbend = message.getPitchWheelValue();
-            double updated_pitchbend = new_pitchbend(&scale, midi_note[message.getChannel()-1], pitchbend);
-            
-            processedMidi.addEvent(juce::MidiMessage::pitchWheel(message.getChannel(), updated_pitchbend), time);
+            member_bend[message.getChannel()-1] = message.getPitchWheelValue();
+            emitBend(tuning, message.getChannel(), time, processedMidi);
         }
-        else
+    }
+    if (overload.isOverloaded())
+    {
+        overloaded_blocks++;
+        shed_events += overload.shedCount();
+        for (int channel = 1; channel <= 16; channel++)
         {
-            processedMidi.addEvent(message, time);
+            if (overload.pending(channel)) flushCoalescedBend(tuning, channel, processedMidi);
         }
     }
+    for (int zone = 0; zone < 2; zone++)
+    {
+        if (master_bend_time[zone] >= 0) flushMasterBend(tuning, zone, processedMidi);
+    }
+    if (adaptive_pending != 0) flushAdaptive(tuning, processedMidi);
+    if (smoothing_active) smoothBends(tuning, processedMidi, buffer.getNumSamples());
+    if (render_cv) renderCV(buffer, rendered, buffer.getNumSamples());
     midiMessages.swapWith (processedMidi);
+    
+    for (int channel = 0; channel < 16; channel++)
+    {
+        live_pitch[channel].store((float) channel_pitch[channel], std::memory_order_relaxed);
+        live_active[channel].store(channel_active[channel], std::memory_order_relaxed);
+    }
 }
 
 //==============================================================================
@@ -320,6 +822,29 @@ void NewProjectAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
         state.removeProperty("path", nullptr);
     }
     if (!error) state.setProperty("path", juce::var(path), nullptr);
+    if (!error && !kbm_path.empty()) state.setProperty("kbm_path", juce::var(kbm_path), nullptr);
+    else state.removeProperty("kbm_path", nullptr);
+    state.setProperty("cv_output", juce::var(cv_output.load()), nullptr);
+    state.setProperty("adaptive_tuning", juce::var(adaptive_tuning.load()), nullptr);
+    state.setProperty("tuning_master", juce::var(tuning_master.load()), nullptr);
+    state.setProperty("overload_protection", juce::var(overload_protection.load()), nullptr);
+    state.setProperty("bend_smoothing", juce::var(bend_smoothing.load()), nullptr);
+    state.setProperty("bend_slew_rate", juce::var(bend_slew_rate.load()), nullptr);
+    
+    // Degrees edited since the scale was loaded, applied again after it is reloaded
+    state.removeChild(state.getChildWithName("degree_edits"), nullptr);
+    juce::ValueTree edits("degree_edits");
+    {
+        lock_guard<mutex> lock(scale_text_lock);
+        for (auto& edit : degree_edits)
+        {
+            juce::ValueTree degree("degree");
+            degree.setProperty("degree", juce::var(edit.first), nullptr);
+            degree.setProperty("value", juce::var(edit.second), nullptr);
+            edits.appendChild(degree, nullptr);
+        }
+    }
+    state.appendChild(edits, nullptr);
    
     // Save tre
     juce::MemoryOutputStream stream(destData, false);
@@ -339,26 +864,40 @@ void NewProjectAudioProcessor::setStateInformation (const void* data, int sizeIn
     {
         // Load state 
          state = tree;
+        cv_output = (bool) state.getProperty("cv_output", false);
+        adaptive_tuning = (bool) state.getProperty("adaptive_tuning", false);
+        if (editor != NULL) editor->cvOutputButton.setToggleState (cv_output, juce::dontSendNotification);
+        if (editor != NULL) editor->adaptiveButton.setToggleState (adaptive_tuning, juce::dontSendNotification);
+        overload_protection = (bool) state.getProperty("overload_protection", false);
+        if (editor != NULL) editor->overloadButton.setToggleState (overload_protection, juce::dontSendNotification);
+        bend_smoothing = (bool) state.getProperty("bend_smoothing", false);
+        bend_slew_rate = (float) (double) state.getProperty("bend_slew_rate", 200.0);
+        if (editor != NULL) editor->smoothingButton.setToggleState (bend_smoothing, juce::dontSendNotification);
+        if (editor != NULL) editor->slewRateSlider.setValue (bend_slew_rate, juce::dontSendNotification);
           
         // Load path
+        kbm_path = state.getProperty("kbm_path", "").toString().toStdString();
+        if (editor != NULL) editor->keyboardMapText.setText (kbm_path, juce::dontSendNotification);
         if (tree.hasProperty("path"))
         {  
            path =  state.getProperty("path").toString().toStdString();
-           error = this->loadFile(path);
-            if (error)
-            { 
-                message = "Error loading file...reverting to 12-ET.";
-                if (editor != NULL) editor->errorText.setColour (juce::Label::textColourId, juce::Colours::orange);
-                if (editor != NULL) editor->errorText.setText (message, juce::dontSendNotification);
-            }
-            else 
-            { 
-                string filename =  path.substr(path.find_last_of("/\\") + 1);
-                message = "Sucessfully loaded: " + filename;
-                if (editor != NULL) editor->errorText.setColour (juce::Label::textColourId, juce::Colours::lightgreen);
-                if (editor != NULL) editor->errorText.setText (message, juce::dontSendNotification);
-            }
+           
+           // Loaded synchronously: the host expects the tuning to be in place when this returns.
+           // An older background load must not publish over it afterwards.
+           loader.removeAllJobs(true, 5000);
+           load_finished = false;
+           load_error = this->loadFile(path, kbm_path);
+           
+           juce::ValueTree edits = state.getChildWithName("degree_edits");
+           for (int i = 0; i < edits.getNumChildren() && !load_error; i++)
+           {
+               juce::ValueTree degree = edits.getChild(i);
+               setDegree((int) degree.getProperty("degree", 0), degree.getProperty("value", "").toString().toStdString());
+           }
+           loadFinished();
         }
+        setTuningMaster((bool) state.getProperty("tuning_master", false));
+        if (editor != NULL) editor->tuningMasterButton.setToggleState (tuning_master, juce::dontSendNotification);
     }
 }
 
@@ -10,20 +10,22 @@
 
 #include <JuceHeader.h>
 #include <string>
+#include <atomic>
+#include <map>
+#include "Tuning.h"
+#include "MPEZones.h"
+#include "AdaptiveTuning.h"
+#include "SharedTuning.h"
+#include "SysExTuning.h"
+#include "OverloadGuard.h"
+#include "PitchCV.h"
 using namespace std;
 
 //==============================================================================
 /**
 */
-class Scale {      
-  public:             
-    string description;
-    int count;
-    double scale_array[128];
-    int i = 0;
-};
-
-class NewProjectAudioProcessor  : public juce::AudioProcessor
+class NewProjectAudioProcessor  : public juce::AudioProcessor,
+                                  private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -31,7 +33,17 @@ public:
     ~NewProjectAudioProcessor() override;
 
     //==============================================================================
-    int loadFile(string filename);
+    int loadFile(string filename, string kbm_filename);
+    void loadFilesAsync();          // loads path and kbm_path on a background thread
+    vector<double> pitchClasses();  // pitches the loaded tuning can play, within one octave
+    
+    // Scale editing, from the message thread. Degrees are numbered as in a .scl file,
+    // 1 up to the period.
+    int getDegreeCount();
+    double getDegreeCents (int degree);
+    string getDegreeText (int degree);
+    bool setDegree (int degree, string value);  // value in cents (with a '.') or as a ratio
+    int exportScale (string filename);
     
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
@@ -67,14 +79,125 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
 
     string path;
-    int error;
+    string kbm_path;  // optional keyboard mapping, compiled together with the scale
+    int error = 0;
     string message;
+    bool loading = false;
+    std::atomic<bool> cv_output { false };  // render each channel's pitch as CV into the audio outputs
+    
+    std::atomic<bool> adaptive_tuning { false };  // keep held chords just, see AdaptiveTuning
+    
+    // Tuning master: publish the note frequencies for other plugins, see SharedTuning.h
+    std::atomic<bool> tuning_master { false };
+    void setTuningMaster (bool enabled);
+    
+    // Overload protection (opt-in): once a block has used its share of the block duration, the
+    // rest of its pitch wheel events are coalesced to the last one per channel, see OverloadGuard.
+    std::atomic<bool> overload_protection { false };
+    std::atomic<juce::uint64> shed_events { 0 };       // pitch wheel events coalesced away
+    std::atomic<juce::uint64> overloaded_blocks { 0 };
+    
+    // Bend smoothing: retuned pitch wheel output is slew-limited per channel, with the steps
+    // filled in by extra pitch wheel events. A new note still starts at its own pitch.
+    std::atomic<bool> bend_smoothing { false };
+    std::atomic<float> bend_slew_rate { 200 };  // semitones per second
+    
+    // Live pitch of each channel, published by the audio thread once per block.
+    std::atomic<float> live_pitch[16] {};
+    std::atomic<bool> live_active[16] {};
     
 private:
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NewProjectAudioProcessor)
     juce::ValueTree state;
-    bool loaded = false;
-    Scale scale;
-    int midi_note[16];
+    TuningExchange tunings;
+    int midi_note[16] = {};
+    int member_bend[16] = {};
+    bool channel_has_note[16] = {};
+    double channel_pitch[16] = {};
+    bool channel_active[16] = {};
+    bool render_cv = false;
+
+    //==============================================================================
+    void emitBend (const Tuning* tuning, int channel, int time, juce::MidiBuffer& out);
+    void flushMasterBend (const Tuning* tuning, int zone, juce::MidiBuffer& out);
+
+    double master_bend[2] = {};             // zone-wide bend from the master channel, in semitones
+    int master_bend_time[2] = { -1, -1 };   // sample position of a master bend still to be applied
+
+    //==============================================================================
+    void flushCoalescedBend (const Tuning* tuning, int channel, juce::MidiBuffer& out);
+
+    OverloadGuard overload;
+
+    //==============================================================================
+    void smoothBends (const Tuning* tuning, juce::MidiBuffer& midi, int num_samples);
+    int slewTick (int time, const float* max_step, juce::MidiBuffer& out);
+
+    bool smoothing_active = false;
+    int slew_interval_samples = 44;         // samples between interpolated pitch wheel events
+    double slew_tick_seconds = 0.001;
+    int slew_next_tick = 0;
+    float slew_current[16] = {};
+    float slew_target[16] = {};
+    int slew_sent[16] = {};                 // last value sent on each channel, -1 if not known
+
+    //==============================================================================
+    void flushAdaptive (const Tuning* tuning, juce::MidiBuffer& out);
+
+    AdaptiveTuning adaptive;
+    bool adaptive_active = false;
+    int adaptive_pending = 0;               // channels whose correction changed but haven't been re-sent
+    int adaptive_time = 0;
+
+    //==============================================================================
+    // Scale text, kept here rather than in Tuning so edits don't copy it for the audio thread.
+    // Any thread but the audio thread, under scale_text_lock: each degree as written, and the
+    // degrees edited since the scale was loaded from path, which are saved with the state.
+    void publishTuning (unique_ptr<Tuning> tuning, vector<string> text, bool from_path);
+    
+    mutex scale_text_lock;
+    vector<string> degree_text;
+    map<int, string> degree_edits;
+    bool scale_from_path = false;
+
+    //==============================================================================
+    void loadFinished();
+    void shareTuning();
+    void loadSysEx();
+    void sysExLoaded();
+
+    SharedTuningWriter shared_tuning;
+
+    juce::ThreadPool loader { 1 };
+    juce::ThreadPool sysex_parser { 1 };  // own queue, so a superseded file load can't drop SysEx
+    std::atomic<bool> load_finished { false };
+    std::atomic<int> load_error { 0 };
+    std::atomic<bool> sysex_loaded { false };
+
+    //==============================================================================
+    // Tuning SysEx is copied here by the audio thread, each message prefixed with its size,
+    // and parsed by loadSysEx() on the sysex_parser thread.
+    bool receiveSysEx (const juce::MidiMessageMetadata& metadata);
+
+    static const int sysex_fifo_size = 65536;
+    juce::AbstractFifo sysex_fifo { sysex_fifo_size };
+    uint8_t sysex_bytes[sysex_fifo_size];
+
+    //==============================================================================
+    void trackZones (const juce::uint8* data, int size);
+    void handleAsyncUpdate() override;
+
+    MPEZones zones;  // audio thread only
+    std::atomic<double> bend_range[2] { { default_member_bend_range }, { default_member_bend_range } };
+
+    //==============================================================================
+    void setCVTarget (int channel, double semitones);
+    void renderCV (juce::AudioBuffer<float>& buffer, int start, int end);
+
+    int cv_ramp_samples = 88;
+    float cv_current[16] = {};
+    float cv_target[16] = {};
+    float cv_step[16] = {};
+    int cv_ramp_remaining[16] = {};
 };
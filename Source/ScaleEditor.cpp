@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+    Live editing of the loaded scale's degrees, and export back to .scl.
+
+  ==============================================================================
+*/
+
+#include "ScaleEditor.h"
+
+const double cents_slider_span = 2400;  // two octaves, the slider's range for ordinary degrees
+
+//==============================================================================
+ScaleEditor::ScaleEditor (NewProjectAudioProcessor& p)
+    : audioProcessor (p)
+{
+    addAndMakeVisible (degreeLabel);
+    degreeLabel.setText ("Degree:", juce::dontSendNotification);
+    degreeLabel.setColour (juce::Label::textColourId, juce::Colours::white);
+
+    addAndMakeVisible (degreeSelector);
+    degreeSelector.setSliderStyle (juce::Slider::IncDecButtons);
+    degreeSelector.setTextBoxStyle (juce::Slider::TextBoxLeft, false, 40, 20);
+    degreeSelector.onValueChange = [this] { showDegree(); };
+
+    addAndMakeVisible (centsSlider);
+    centsSlider.setSliderStyle (juce::Slider::LinearHorizontal);
+    centsSlider.setTextBoxStyle (juce::Slider::TextBoxRight, false, 70, 20);
+    centsSlider.setRange (0, cents_slider_span, 0.001);
+    centsSlider.setTextValueSuffix (" c");
+    centsSlider.onValueChange = [this]
+    {
+        setDegree (juce::String (centsSlider.getValue(), 3).toStdString());  // always has a '.', so read as cents
+    };
+
+    // Value Label Code (cents or ratio)
+    addAndMakeVisible (valueText);
+    valueText.setEditable (true);
+    valueText.setColour (juce::Label::backgroundColourId, juce::Colours::white);
+    valueText.setColour (juce::Label::textWhenEditingColourId, juce::Colours::black);
+    valueText.setColour (juce::Label::textColourId, juce::Colours::black);
+    valueText.onTextChange = [this]
+    {
+        setDegree (valueText.getText().toStdString());
+        showDegree();
+    };
+
+    // Export Label Code
+    addAndMakeVisible (exportText);
+    exportText.setEditable (true);
+    exportText.setColour (juce::Label::backgroundColourId, juce::Colours::white);
+    exportText.setColour (juce::Label::textWhenEditingColourId, juce::Colours::black);
+    exportText.setColour (juce::Label::textColourId, juce::Colours::black);
+
+    addAndMakeVisible (exportButton);
+    exportButton.onClick = [this]
+    {
+        bool ok = audioProcessor.exportScale (exportText.getText().toStdString()) == 0;
+        exportButton.setButtonText (ok ? "Exported" : "Export failed");
+    };
+
+    refresh();
+}
+
+ScaleEditor::~ScaleEditor()
+{
+}
+
+void ScaleEditor::refresh()
+{
+    int count = audioProcessor.getDegreeCount();
+    setEnabled (count > 0);
+    degreeSelector.setRange (1, juce::jmax (1, count), 1);
+    degreeSelector.setValue (juce::jlimit (1.0, (double) juce::jmax (1, count), degreeSelector.getValue()),
+                             juce::dontSendNotification);
+    exportText.setText (audioProcessor.path, juce::dontSendNotification);
+    exportButton.setButtonText ("Export .scl");
+    showDegree();
+}
+
+void ScaleEditor::showDegree()
+{
+    int degree = (int) degreeSelector.getValue();
+    double cents = audioProcessor.getDegreeCents (degree);
+    
+    // The range follows the degree, so one lying below 0 or past two octaves isn't clamped
+    // when shown, and then written back clamped by the next drag.
+    centsSlider.setRange (juce::jmin (0.0, cents - cents_slider_span / 2),
+                          juce::jmax (cents_slider_span, cents + cents_slider_span / 2), 0.001);
+    centsSlider.setValue (cents, juce::dontSendNotification);
+    valueText.setText (audioProcessor.getDegreeText (degree), juce::dontSendNotification);
+}
+
+void ScaleEditor::setDegree (string value)
+{
+    if (!audioProcessor.setDegree ((int) degreeSelector.getValue(), value)) return;
+
+    valueText.setText (value, juce::dontSendNotification);
+    exportButton.setButtonText ("Export .scl");
+    if (onEdit) onEdit();
+}
+
+//==============================================================================
+void ScaleEditor::resized()
+{
+    int width = getWidth();
+    degreeLabel.setBounds (0, 0, 70, 20);
+    degreeSelector.setBounds (70, 0, 110, 20);
+    valueText.setBounds (190, 0, width - 190, 20);
+    centsSlider.setBounds (0, 25, width, 20);
+    exportText.setBounds (0, 50, width - 110, 20);
+    exportButton.setBounds (width - 100, 50, 100, 20);
+}
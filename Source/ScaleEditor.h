@@ -0,0 +1,44 @@
+/*
+  ==============================================================================
+
+    Live editing of the loaded scale's degrees, and export back to .scl.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+//==============================================================================
+/** Pick a degree, then drag its slider (cents) or type a cents value or ratio.
+    Every change goes straight to the processor, which recompiles only the keys
+    playing that degree.
+*/
+class ScaleEditor  : public juce::Component
+{
+public:
+    ScaleEditor (NewProjectAudioProcessor&);
+    ~ScaleEditor() override;
+
+    void refresh();                  // call when a different scale has been loaded
+    std::function<void()> onEdit;    // called after each successful change
+
+    //==============================================================================
+    void resized() override;
+
+private:
+    void showDegree();
+    void setDegree (string value);
+
+    NewProjectAudioProcessor& audioProcessor;
+    juce::Label degreeLabel;
+    juce::Slider degreeSelector;
+    juce::Slider centsSlider;
+    juce::Label valueText;
+    juce::Label exportText;
+    juce::TextButton exportButton { "Export .scl" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ScaleEditor)
+};
@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    The compiled tuning, shared through memory with other plugins and programs.
+
+  ==============================================================================
+*/
+
+#include "SharedTuning.h"
+#include <mutex>
+
+// Instances in one process share the file lock, so ownership within the process is
+// tracked here; the inter-process lock keeps masters in other processes out.
+static std::mutex master_mutex;
+static SharedTuningWriter* master = nullptr;
+
+SharedTuningWriter::~SharedTuningWriter()
+{
+    close();
+}
+
+bool SharedTuningWriter::open (const juce::String& name)
+{
+    std::lock_guard<std::mutex> lock (master_mutex);
+    if (master == this) return true;
+    if (master != nullptr) return false;
+
+    master_lock.reset (new juce::InterProcessLock (name + ".tuning"));
+    if (!master_lock->enter (0))
+    {
+        master_lock.reset();
+        return false;
+    }
+
+    // Only (re)size the file when it is wrong, a reader may have it mapped.
+    juce::File file = shared_tuning_file (name);
+    bool sized = file.getSize() == (juce::int64) sizeof (SharedTuningSegment);
+    if (!sized)
+    {
+        juce::MemoryBlock zeros (sizeof (SharedTuningSegment), true);
+        sized = file.replaceWithData (zeros.getData(), zeros.getSize());
+    }
+
+    if (sized)
+    {
+        mapping.reset (new juce::MemoryMappedFile (file, juce::MemoryMappedFile::readWrite));
+        segment = static_cast<SharedTuningSegment*> (mapping->getData());
+    }
+    if (segment == nullptr || mapping->getSize() < sizeof (SharedTuningSegment))
+    {
+        segment = nullptr;
+        mapping.reset();
+        master_lock->exit();
+        master_lock.reset();
+        return false;
+    }
+
+    segment->magic = shared_tuning_magic;
+    segment->layout_version = shared_tuning_layout_version;
+    master = this;
+    return true;
+}
+
+void SharedTuningWriter::close()
+{
+    std::lock_guard<std::mutex> lock (master_mutex);
+    if (master != this) return;
+
+    write_shared_tuning (segment, nullptr, false);  // readers see the master has gone
+    segment = nullptr;
+    mapping.reset();
+    master_lock->exit();
+    master_lock.reset();
+    master = nullptr;
+}
+
+void SharedTuningWriter::write (const double frequency[128])
+{
+    std::lock_guard<std::mutex> lock (master_mutex);
+    if (master != this) return;
+
+    write_shared_tuning (segment, frequency);
+}
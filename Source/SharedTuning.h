@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    The compiled tuning, shared through memory with other plugins and programs.
+
+    A plugin in tuning master mode keeps a 128-note frequency table in a small
+    memory-mapped file, /tmp/ScalaMPE.tuning. Readers map the same file and look
+    notes up in O(1), with no MIDI involved. Writes are guarded by a sequence
+    counter (a seqlock), so neither side ever blocks: the counter is odd while a
+    write is in progress, and a reader retries if it changed underneath it.
+
+    There is one master at a time, across every instance in every process: the
+    first to open the writer owns the segment until it closes it.
+
+    This header is all a reader needs; readers without JUCE can map the file
+    themselves and use SharedTuningSegment.h:
+
+        SharedTuningReader reader;
+        double hz;
+        if (reader.open() && reader.frequency (note, hz)) ...
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include "SharedTuningSegment.h"
+
+inline juce::File shared_tuning_file (const juce::String& name = "ScalaMPE")
+{
+    return juce::File (shared_tuning_path).getSiblingFile (name + ".tuning");
+}
+
+//==============================================================================
+/** Publishes the tuning. Used by the plugin from non-audio threads only.
+    open() fails while another writer, in this process or another, is the master.
+*/
+class SharedTuningWriter {
+  public:
+    ~SharedTuningWriter();
+
+    bool open (const juce::String& name = "ScalaMPE");
+    void close();
+    void write (const double frequency[128]);
+
+  private:
+    std::unique_ptr<juce::InterProcessLock> master_lock;
+    std::unique_ptr<juce::MemoryMappedFile> mapping;
+    SharedTuningSegment* segment = nullptr;
+};
+
+//==============================================================================
+/** Reads the tuning published by a master. Lock-free and wait-free in practice,
+    so it is safe to call from an audio thread once open() has succeeded.
+*/
+class SharedTuningReader {
+  public:
+    bool open (const juce::String& name = "ScalaMPE")
+    {
+        juce::File file = shared_tuning_file (name);
+        if (file.getSize() < (juce::int64) sizeof (SharedTuningSegment)) return false;
+
+        mapping.reset (new juce::MemoryMappedFile (file, juce::MemoryMappedFile::readOnly));
+        segment = static_cast<const SharedTuningSegment*> (mapping->getData());
+        if (segment == nullptr || mapping->getSize() < sizeof (SharedTuningSegment) || !is_shared_tuning_segment (segment))
+        {
+            segment = nullptr;
+            mapping.reset();
+        }
+        return segment != nullptr;
+    }
+
+    // Frequency of a MIDI note in Hz. False if no master is publishing or the master
+    // kept writing through every attempt. version changes whenever the tuning does.
+    bool frequency (int note, double& hz, uint32_t* version = nullptr) const
+    {
+        return segment != nullptr && read_shared_tuning (segment, note, hz, version);
+    }
+
+  private:
+    std::unique_ptr<juce::MemoryMappedFile> mapping;
+    const SharedTuningSegment* segment = nullptr;
+};
@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    Layout of the shared tuning segment and its seqlock, without any JUCE
+    dependency, so readers outside the plugin can use it as it is.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+//==============================================================================
+// Every process maps the same file. This has to be a fixed path: the temp directory
+// JUCE and $TMPDIR give is private to each application on macOS.
+const char* const shared_tuning_path = "/tmp/ScalaMPE.tuning";
+
+const uint32_t shared_tuning_magic = 0x45504d53;  // "SMPE"
+const uint32_t shared_tuning_layout_version = 1;
+
+/** Layout of the shared segment. Frequencies are in Hz, stored as the bit
+    patterns of doubles so they can be read atomically; unmapped keys are 0.
+*/
+struct SharedTuningSegment {
+    uint32_t magic;
+    uint32_t layout_version;
+    std::atomic<uint32_t> sequence;  // odd while the master is writing
+    std::atomic<uint32_t> active;    // 0 once the master has stopped publishing
+    std::atomic<uint64_t> frequency[128];
+};
+
+static_assert (std::atomic<uint64_t>::is_always_lock_free, "shared tuning needs lock-free 64-bit atomics");
+
+inline bool is_shared_tuning_segment (const SharedTuningSegment* segment)
+{
+    return segment->magic == shared_tuning_magic && segment->layout_version == shared_tuning_layout_version;
+}
+
+// Frequency of a MIDI note in Hz. False if no master is publishing or the master kept
+// writing through every attempt. version changes whenever the tuning does.
+inline bool read_shared_tuning (const SharedTuningSegment* segment, int note, double& hz, uint32_t* version = nullptr)
+{
+    if (note < 0 || note > 127) return false;
+
+    for (int attempt = 0; attempt < 64; attempt++)
+    {
+        uint32_t before = segment->sequence.load (std::memory_order_acquire);
+        if (before & 1) continue;
+
+        uint32_t active = segment->active.load (std::memory_order_relaxed);
+        uint64_t bits = segment->frequency[note].load (std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_acquire);
+
+        if (segment->sequence.load (std::memory_order_relaxed) == before)
+        {
+            if (!active) return false;
+            std::memcpy (&hz, &bits, sizeof (hz));
+            if (version != nullptr) *version = before;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Writer side. Only one writer may use a segment at a time.
+inline void write_shared_tuning (SharedTuningSegment* segment, const double frequency[128], bool active = true)
+{
+    uint32_t sequence = segment->sequence.load (std::memory_order_relaxed);
+    if (sequence & 1) sequence++;  // a previous master died mid-write
+    segment->sequence.store (sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+
+    for (int note = 0; frequency != nullptr && note < 128; note++)
+    {
+        uint64_t bits;
+        std::memcpy (&bits, &frequency[note], sizeof (bits));
+        segment->frequency[note].store (bits, std::memory_order_relaxed);
+    }
+    segment->active.store (active ? 1 : 0, std::memory_order_relaxed);
+    segment->sequence.store (sequence + 2, std::memory_order_release);
+}
@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+    Tunings received as MIDI System Exclusive messages.
+
+  ==============================================================================
+*/
+
+#include "SysExTuning.h"
+#include <sstream>
+#include <cstdio>
+#include <math.h>
+using namespace std;
+
+const uint8_t sysex_start = 0xF0;
+const uint8_t sysex_end = 0xF7;
+const uint8_t sysex_non_commercial = 0x7D;
+const uint8_t sysex_non_realtime = 0x7E;
+const uint8_t mts_sub_id = 0x08;
+const uint8_t mts_bulk_dump = 0x01;
+const uint8_t mts_bank_bulk_dump = 0x04;
+
+bool is_scale_upload(const uint8_t *data, int size)
+{
+  return size > sysex_scale_header_size && data[1] == sysex_non_commercial
+         && data[2] == 'S' && data[3] == 'C' && data[4] == 'L';
+}
+
+// Offset of the 16 byte name, 0 if this isn't a bulk dump.
+int bulk_dump_name_offset(const uint8_t *data, int size)
+{
+  if (size < 5 || data[1] != sysex_non_realtime || data[3] != mts_sub_id) return 0;
+  if (data[4] == mts_bulk_dump && size == mts_bulk_dump_size) return 6;
+  if (data[4] == mts_bank_bulk_dump && size == mts_bulk_dump_size + 1) return 7;
+  return 0;
+}
+
+bool is_tuning_sysex(const uint8_t *data, int size)
+{
+  if (size < 2 || data[0] != sysex_start || data[size-1] != sysex_end) return false;
+  return is_scale_upload(data, size) || bulk_dump_name_offset(data, size) != 0;
+}
+
+// Degrees are written back as cents, always with a '.' so the text reads as cents again.
+string cents_text(double semitones)
+{
+  char text[32];
+  snprintf(text, sizeof(text), "%.5f", semitones * 100);
+  return text;
+}
+
+int interpret_scale_upload(const uint8_t *data, int size, const Tuning *current, Tuning *tuning,
+                           vector<string> *degree_text)
+{
+  istringstream stream(string((const char*) data + sysex_scale_header_size, size - sysex_scale_header_size - 1));
+  tuning->scale.scale_array[0] = NAN;  // set by the period, the last degree
+  try
+  {
+    if (interpretFile(&tuning->scale, &stream, degree_text)) return 1;
+  }
+  catch (const exception&)
+  {
+    return 1;  // stoi/stof on a malformed line
+  }
+  if (tuning->scale.count < 1 || tuning->scale.count > 128 || !isfinite(tuning->scale.scale_array[0])) return 1;
+  
+  tuning->has_keyboard = current != nullptr && current->has_keyboard;
+  if (tuning->has_keyboard) tuning->keyboard = current->keyboard;
+  return 0;
+}
+
+int interpret_bulk_dump(const uint8_t *data, int size, const Tuning *current, Tuning *tuning,
+                        vector<string> *degree_text)
+{
+  int name = bulk_dump_name_offset(data, size);
+  int frequencies = name + 16;
+  
+  uint8_t checksum = 0;
+  for (int i = 1; i < frequencies + 128 * 3; i++) checksum ^= data[i];
+  if ((checksum & 0x7F) != data[frequencies + 128 * 3]) return 1;
+  
+  string description((const char*) data + name, 16);
+  tuning->scale.description = description.substr(0, description.find_last_not_of(' ') + 1);
+  tuning->scale.count = 128;
+  degree_text->assign(128, "");
+  for (int note = 0; note < 128; note++)
+  {
+    const uint8_t *entry = data + frequencies + note * 3;
+    double pitch;
+    if (entry[0] == 0x7F && entry[1] == 0x7F && entry[2] == 0x7F)
+    {
+      pitch = current != nullptr ? current->note_pitch[note] : note;  // no change
+    }
+    else
+    {
+      pitch = entry[0] + ((entry[1] << 7) | entry[2]) / 16384.0;
+    }
+    // Without a mapping note n plays scale_array[n]; index 0 doubles as the period, an octave up.
+    tuning->scale.scale_array[note] = pitch;
+    (*degree_text)[note] = cents_text(note == 0 ? pitch + 12 : pitch);
+  }
+  tuning->has_keyboard = false;
+  tuning->per_key = true;
+  return 0;
+}
+
+int interpret_tuning_sysex(const uint8_t *data, int size, const Tuning *current, Tuning *tuning,
+                           vector<string> *degree_text)
+{
+  if (!is_tuning_sysex(data, size)) return 1;
+  if (is_scale_upload(data, size)) return interpret_scale_upload(data, size, current, tuning, degree_text);
+  return interpret_bulk_dump(data, size, current, tuning, degree_text);
+}
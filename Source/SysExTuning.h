@@ -0,0 +1,34 @@
+/*
+  ==============================================================================
+
+    Tunings received as MIDI System Exclusive messages.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+#include "Tuning.h"
+
+//==============================================================================
+// Two kinds of message are recognised, given as raw bytes from F0 to F7:
+//
+//   Scale upload:    F0 7D 53 43 4C <text of a .scl file, 7-bit ASCII> F7
+//                    (7D is the non-commercial manufacturer ID, then "SCL")
+//   MTS bulk dump:   F0 7E <device> 08 01 <program> <16 byte name> <128 x xx yy zz> <checksum> F7
+//                    and the banked form 08 04 <bank> <program> ..., any device ID.
+//
+// An uploaded scale keeps the keyboard mapping of the current tuning. A bulk dump
+// tunes every key on its own, so it becomes a 128 degree scale without a mapping
+// (Tuning::per_key); keys marked 7F 7F 7F keep their current pitch.
+
+const int sysex_scale_header_size = 5;
+const int mts_bulk_dump_size = 408;       // unbanked, F0 and F7 included
+
+bool is_tuning_sysex(const uint8_t *data, int size);
+
+// Fills in tuning's scale and keyboard mapping, ready for compile_tuning(), and degree_text
+// as interpretFile() does. current may be nullptr. Returns 1 if the message is malformed.
+int interpret_tuning_sysex(const uint8_t *data, int size, const Tuning *current, Tuning *tuning,
+                           vector<string> *degree_text);
@@ -0,0 +1,429 @@
+/*
+  ==============================================================================
+
+    Scala scales and the retuning tables compiled from them.
+
+  ==============================================================================
+*/
+
+#include "Tuning.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <algorithm>
+#include <math.h>
+using namespace std;
+
+int isComment(string str)
+{
+  return str.length() && str.at(0) == '!';
+}
+
+string trimmed(string str)
+{
+  size_t start = str.find_first_not_of(" \t\r");
+  size_t end = str.find_last_not_of(" \t\r");
+  return start == string::npos ? "" : str.substr(start, end - start + 1);
+}
+
+double interpretValue(string str)
+{
+    if (str.find('.') != string::npos)
+    {
+        return stof(str) / 100;
+    }
+    else
+    {
+      int pos = str.find("/");
+      if (pos != string::npos)
+      {
+        string num = str.substr(0, pos);
+        string den = str.substr(pos+1, str.length() - pos);
+	    return 12.0 * log2(stof(num) / stof(den));
+      }
+      else
+      {
+	    return 12.0 * log2(stof(str));
+      }
+    }
+}
+
+int interpretLine(Scale *scale, vector<string> *degree_text, string line, int line_num)
+{
+  if (line_num == 0)
+  {
+    scale->description = line;
+  }
+  else if (line_num == 1)
+  {
+    scale->count = stoi(line);
+    if (scale->count < 0 || scale->count > 128) return 1;  // more degrees than scale_array holds
+  }
+  else
+  {
+    if (scale->i+1 < scale->count && scale->i+1 < 128)
+    {
+      scale->scale_array[++scale->i] = interpretValue(line);
+      if (degree_text) (*degree_text)[scale->i] = trimmed(line);
+    }
+    else if (scale->i+1 == scale->count)
+    {
+        scale->scale_array[0] = interpretValue(line) - 12;
+        if (degree_text) (*degree_text)[0] = trimmed(line);
+    }
+  }
+    return 0;
+}
+
+int interpretFile(Scale *scale, istream *file, vector<string> *degree_text)
+{
+  string line;
+  int line_num = 0;
+  if (degree_text) degree_text->assign(128, "");
+  if (file->good())
+  {
+    bool has_error = true;
+    while (getline(*file, line))
+    {
+      has_error = false;
+      if (!isComment(line))
+      {
+	    if (interpretLine(scale, degree_text, line, line_num)) return 1;
+        line_num++;
+      }
+    }
+    cout << "\n";
+    return has_error; // return 1 if error
+  }
+
+  else
+  {
+    cout << "Unable to open file\n";
+    return 1;
+  }
+}
+
+double scale_value(double value, double dmin, double dmax, double cmin, double cmax)
+{
+  double drange = (dmax - dmin);
+  double crange = (cmax - cmin);
+  return (((value - dmin) * crange) / drange) + cmin;
+}
+
+// Writes the scale back out in .scl format, the period (index 0) last.
+int writeFile(const Scale *scale, const vector<string>& degree_text, ofstream *file)
+{
+  if (!file->good()) return 1;
+  
+  *file << "! Exported by ScalaMPE\n!\n";
+  *file << scale->description << "\n";
+  *file << " " << scale->count << "\n!\n";
+  for (int degree = 1; degree <= scale->count; degree++)
+  {
+    *file << " " << degree_text[degree % scale->count] << "\n";
+  }
+  return !file->good();  // return 1 if error
+}
+
+// Scale degree played by a key, false if the mapping leaves it unmapped.
+bool keyboard_degree(const KeyboardMap *map, int midi_note, int *degree)
+{
+  int offset = midi_note - map->middle_note;
+  if (map->size == 0)
+  {
+    *degree = offset;
+    return true;
+  }
+  int octave = (int) floor((double) offset / map->size);
+  int entry = map->mapping[offset - octave * map->size];
+  *degree = entry + octave * map->octave_degree;
+  return entry >= 0;
+}
+
+int interpretKeyboardLine(KeyboardMap *map, string line, int line_num)
+{
+  switch (line_num)
+  {
+    case 0: map->size = stoi(line); break;
+    case 1: map->first_note = stoi(line); break;
+    case 2: map->last_note = stoi(line); break;
+    case 3: map->middle_note = stoi(line); break;
+    case 4: map->reference_note = stoi(line); break;
+    case 5: map->reference_frequency = stod(line); break;
+    case 6: map->octave_degree = stoi(line); break;
+    default:
+      if (map->i < map->size && map->i < 128)
+      {
+        size_t start = line.find_first_not_of(" \t");
+        map->mapping[map->i++] = (start != string::npos && line[start] == 'x') ? -1 : stoi(line);
+      }
+  }
+  return 0;
+}
+
+int interpretKeyboardFile(KeyboardMap *map, istream *file)
+{
+  string line;
+  int line_num = 0;
+  if (!file->good())
+  {
+    cout << "Unable to open keyboard mapping\n";
+    return 1;
+  }
+  
+  try
+  {
+    while (getline(*file, line))
+    {
+      if (!isComment(line) && line.find_first_not_of(" \t\r") != string::npos)
+      {
+        interpretKeyboardLine(map, line, line_num);
+        line_num++;
+      }
+    }
+  }
+  catch (const exception&)
+  {
+    return 1;  // stoi/stod on a malformed line
+  }
+  
+  for (int entry = map->i; entry < 128; entry++) map->mapping[entry] = -1;  // missing entries are unmapped
+  
+  int reference_degree;
+  return line_num < 7 || map->size < 0 || map->size > 128 || map->reference_frequency <= 0
+         || map->first_note < 0 || map->last_note > 127 || map->first_note > map->last_note
+         || !keyboard_degree(map, map->reference_note, &reference_degree);  // return 1 if error
+}
+
+double semitones_to_pitchbend(double value, double bend_range)
+{
+  return value * 8192 / bend_range;
+}
+
+double pitchbend_to_semitones(double value, double bend_range)
+{
+  return value * bend_range / 8192;
+}
+
+double midi_note_scala(const Scale *scale, int midi_note)
+{
+  int octave = (int) floor((double) midi_note / scale->count);
+  return scale->scale_array[midi_note - octave * scale->count] + octave * 12;
+}
+
+int clamp_pitchbend(double value)
+{
+  int pitchbend = (int) lround(value);
+  return pitchbend < 0 ? 0 : (pitchbend > 16383 ? 16383 : pitchbend);
+}
+
+//==============================================================================
+// The keyboard mapping with its octave filled in, and the pitch the scale's degree 0 sits at.
+KeyboardMap effective_keyboard(const Tuning *tuning, double *reference_pitch)
+{
+  KeyboardMap map = tuning->keyboard;
+  *reference_pitch = 0;
+  if (!tuning->has_keyboard) return map;
+  
+  // Every key is tuned relative to the reference note, which sounds at the reference frequency.
+  if (map.octave_degree == 0) map.octave_degree = tuning->scale.count;
+  int reference_degree;
+  keyboard_degree(&map, map.reference_note, &reference_degree);
+  *reference_pitch = 69 + 12 * log2(map.reference_frequency / 440)
+                     - midi_note_scala(&tuning->scale, reference_degree);
+  return map;
+}
+
+// Scale degree a key plays, false if it keeps its 12-ET pitch.
+bool note_degree(const Tuning *tuning, const KeyboardMap *map, int note, int *degree)
+{
+  if (!tuning->has_keyboard)
+  {
+    *degree = note;
+    return true;
+  }
+  if (note < map->first_note || note > map->last_note) return false;  // outside the retuned range
+  return keyboard_degree(map, note, degree);
+}
+
+void compile_note(Tuning *tuning, const KeyboardMap *map, double reference_pitch, int note)
+{
+  int degree;
+  if (note_degree(tuning, map, note, &degree))
+  {
+    tuning->note_pitch[note] = reference_pitch + midi_note_scala(&tuning->scale, degree);
+    tuning->note_mapped[note] = true;
+  }
+  else
+  {
+    tuning->note_pitch[note] = note;
+    tuning->note_mapped[note] = note < map->first_note || note > map->last_note;  // 12-ET outside the range, silent if unmapped
+  }
+}
+
+void compile_note_bend(Tuning *tuning, int zone, int note)
+{
+  double offset = tuning->note_pitch[note] - note;
+  tuning->note_bend[zone][note] = clamp_pitchbend(semitones_to_pitchbend(offset, tuning->bend_range[zone]) + 8192);
+}
+
+void compile_notes(Tuning *tuning)
+{
+  double reference_pitch;
+  KeyboardMap map = effective_keyboard(tuning, &reference_pitch);
+  for (int note = 0; note < 128; note++)
+  {
+    compile_note(tuning, &map, reference_pitch, note);
+  }
+}
+
+void compile_zone(Tuning *tuning, int zone)
+{
+  for (int note = 0; note < 128; note++)
+  {
+    compile_note_bend(tuning, zone, note);
+  }
+}
+
+int scale_index(const Scale *scale, int degree)
+{
+  int index = degree % scale->count;
+  return index < 0 ? index + scale->count : index;
+}
+
+// After scale_array[index] has changed, recompiles only the keys that play that degree.  If the
+// keyboard mapping's reference note plays it, every key moves and the whole table is rebuilt.
+void compile_degree(Tuning *tuning, int index)
+{
+  double reference_pitch;
+  KeyboardMap map = effective_keyboard(tuning, &reference_pitch);
+  int degree;
+  if (tuning->has_keyboard)
+  {
+    keyboard_degree(&map, map.reference_note, &degree);
+    if (scale_index(&tuning->scale, degree) == index)
+    {
+      compile_notes(tuning);
+      compile_zone(tuning, 0);
+      compile_zone(tuning, 1);
+      return;
+    }
+  }
+  
+  for (int note = 0; note < 128; note++)
+  {
+    if (!note_degree(tuning, &map, note, &degree) || scale_index(&tuning->scale, degree) != index) continue;
+    compile_note(tuning, &map, reference_pitch, note);
+    compile_note_bend(tuning, 0, note);
+    compile_note_bend(tuning, 1, note);
+  }
+}
+
+void compile_tuning(Tuning *tuning, const double bend_range[2])
+{
+  compile_notes(tuning);
+  for (int zone = 0; zone < 2; zone++)
+  {
+    tuning->bend_range[zone] = bend_range[zone];
+    compile_zone(tuning, zone);
+  }
+}
+
+// Pitch of any key, including ones past either end of the table: those follow the scale
+// outward (through the keyboard mapping's repeat, if there is one) instead of stopping.
+// A tuning set key by key has no repeat, so it carries on from the end key in 12-ET steps.
+double extended_pitch(const Tuning *tuning, int note)
+{
+  if (note >= 0 && note < 128) return tuning->note_pitch[note];
+  
+  int edge = note < 0 ? 0 : 127;
+  if (tuning->per_key) return tuning->note_pitch[edge] + (note - edge);
+  
+  double reference_pitch;
+  KeyboardMap map = effective_keyboard(tuning, &reference_pitch);
+  int degree = note;
+  if (tuning->has_keyboard && !keyboard_degree(&map, note, &degree))
+  {
+    return tuning->note_pitch[edge] + (note - edge);  // unmapped key, carry on in 12-ET steps
+  }
+  return reference_pitch + midi_note_scala(&tuning->scale, degree);
+}
+
+// master_bend is the zone-wide bend from the MPE master channel, in semitones.  It is added to
+// the played pitch before retuning, so a master bend glides through the scale like a note bend.
+int new_pitchbend(const Tuning *tuning, int zone, int midi_note, int pitchbend, double master_bend)
+{
+  if (pitchbend == 8192 && master_bend == 0) return tuning->note_bend[zone][midi_note];
+  
+  double bend_range = tuning->bend_range[zone];
+  double midi_note_f = midi_note + pitchbend_to_semitones(pitchbend - 8192, bend_range) + master_bend;
+  int below = (int) floor(midi_note_f);
+  double new_midi_note_f = scale_value(midi_note_f,
+                                       below,
+                                       below + 1,
+                                       extended_pitch(tuning, below),
+                                       extended_pitch(tuning, below + 1));
+  return clamp_pitchbend(semitones_to_pitchbend(new_midi_note_f - midi_note, bend_range) + 8192);
+}
+
+//==============================================================================
+TuningExchange::~TuningExchange()
+{
+  delete current.load();
+}
+
+void TuningExchange::publish(unique_ptr<Tuning> tuning)
+{
+  lock_guard<mutex> lock(writer_lock);
+  swap(tuning.release());
+}
+
+bool TuningExchange::update(function<bool(Tuning&)> edit)
+{
+  lock_guard<mutex> lock(writer_lock);
+  if (current.load() == nullptr) return false;
+  
+  unique_ptr<Tuning> tuning(new Tuning(*current.load()));
+  if (!edit(*tuning)) return false;
+  swap(tuning.release());
+  return true;
+}
+
+void TuningExchange::read(function<void(const Tuning*)> reader)
+{
+  lock_guard<mutex> lock(writer_lock);
+  reader(current.load());
+}
+
+// Called with writer_lock held.
+void TuningExchange::swap(Tuning *tuning)
+{
+  Tuning *old = current.exchange(tuning);
+  uint32_t stamp = epoch.load();
+  
+  // Anything retired during an earlier block is no longer visible to the audio thread.
+  retired.erase(remove_if(retired.begin(), retired.end(),
+                          [stamp](const pair<uint32_t, unique_ptr<Tuning>>& r) { return r.first != stamp; }),
+                retired.end());
+  
+  if (old == nullptr) return;
+  if (stamp & 1)
+  {
+    retired.push_back(make_pair(stamp, unique_ptr<Tuning>(old)));  // audio thread may still hold it
+  }
+  else
+  {
+    delete old;  // audio thread is between blocks and will pick up the new tuning
+  }
+}
+
+const Tuning* TuningExchange::beginBlock()
+{
+  epoch++;
+  return current.load();
+}
+
+void TuningExchange::endBlock()
+{
+  epoch++;
+}
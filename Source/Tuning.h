@@ -0,0 +1,121 @@
+/*
+  ==============================================================================
+
+    Scala scales and the retuning tables compiled from them.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <cstdint>
+using namespace std;
+
+//==============================================================================
+/**
+*/
+class Scale {
+  public:
+    string description;
+    int count;
+    double scale_array[128];
+    int i = 0;
+};
+
+/** A Scala keyboard mapping (.kbm): which scale degree each MIDI note plays and
+    the frequency the scale is anchored to.
+*/
+class KeyboardMap {
+  public:
+    int size = 0;                     // 0 maps every key to consecutive degrees
+    int first_note = 0;
+    int last_note = 127;
+    int middle_note = 0;              // key that plays the first mapping entry
+    int reference_note = 69;
+    double reference_frequency = 440;
+    int octave_degree = 0;            // degree the mapping repeats at, 0 for the scale size
+    int mapping[128];                 // degree for each entry, -1 for unmapped keys
+    int i = 0;
+};
+
+// MPE default pitch bend ranges, in semitones, until a controller announces its own.
+const double default_member_bend_range = 48;
+const double default_master_bend_range = 2;
+
+//==============================================================================
+/** Everything the audio thread needs to retune a note, compiled ahead of time.
+    Zone 0 is the MPE lower zone, zone 1 the upper zone.
+*/
+class Tuning {
+  public:
+    Scale scale;
+    KeyboardMap keyboard;
+    bool has_keyboard = false;    // without one, note 0 plays degree 0 at 12-ET note 0
+    bool per_key = false;         // tuned key by key (MTS bulk dump): no scale repeats past the table
+    double note_pitch[128];       // retuned pitch of each MIDI note, in 12-ET semitones
+    bool note_mapped[128];        // false for keys the keyboard mapping leaves silent
+    double bend_range[2];         // member bend range each zone's table was compiled for
+    int note_bend[2][128];        // pitch wheel value that retunes each note at neutral bend
+};
+
+// Any stream holding .scl text.  degree_text, if given, gets each degree as written (cents or
+// ratio), indexed like scale_array; the text is kept out of Scale so tunings copy cheaply.
+int interpretFile(Scale *scale, istream *file, vector<string> *degree_text = nullptr);
+double interpretValue(string str);
+int writeFile(const Scale *scale, const vector<string>& degree_text, ofstream *file);
+int interpretKeyboardFile(KeyboardMap *map, istream *file);
+
+double semitones_to_pitchbend(double value, double bend_range);
+double pitchbend_to_semitones(double value, double bend_range);
+int clamp_pitchbend(double value);
+
+void compile_notes(Tuning *tuning);
+void compile_zone(Tuning *tuning, int zone);
+void compile_degree(Tuning *tuning, int index);
+int scale_index(const Scale *scale, int degree);
+void compile_tuning(Tuning *tuning, const double bend_range[2]);
+
+int new_pitchbend(const Tuning *tuning, int zone, int midi_note, int pitchbend, double master_bend = 0);
+
+//==============================================================================
+/** Hands compiled tunings to the audio thread without it ever taking a lock.
+    Writers build a complete Tuning and publish it; the audio thread picks up the
+    latest one at the start of each block and uses it until the end of that block.
+    A replaced tuning is only freed once the audio thread can no longer be using it.
+*/
+class TuningExchange {
+  public:
+    ~TuningExchange();
+
+    // Writer side, any thread but the audio thread.
+    void publish(unique_ptr<Tuning> tuning);
+    bool update(function<bool(Tuning&)> edit);  // edits a copy of the current tuning, publishes it if edit returns true
+    void read(function<void(const Tuning*)> reader);  // current tuning, nullptr if none
+
+    // Audio side.
+    class ScopedRead {
+      public:
+        ScopedRead(TuningExchange& e) : exchange(e), tuning(e.beginBlock()) {}
+        ~ScopedRead() { exchange.endBlock(); }
+        TuningExchange& exchange;
+        const Tuning* const tuning;
+    };
+
+  private:
+    const Tuning* beginBlock();
+    void endBlock();
+    void swap(Tuning *tuning);
+
+    mutex writer_lock;
+    atomic<Tuning*> current { nullptr };
+    atomic<uint32_t> epoch { 0 };  // odd while the audio thread is inside a block
+    vector<pair<uint32_t, unique_ptr<Tuning>>> retired;
+};
@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    Shows the loaded scale and the live pitch of each MPE channel.
+
+  ==============================================================================
+*/
+
+#include "TuningVisualizer.h"
+#include <math.h>
+
+const int visualizer_frame_rate = 30;
+
+//==============================================================================
+TuningVisualizer::TuningVisualizer (NewProjectAudioProcessor& p)
+    : audioProcessor (p)
+{
+    startTimerHz (visualizer_frame_rate);
+}
+
+TuningVisualizer::~TuningVisualizer()
+{
+    stopTimer();
+}
+
+void TuningVisualizer::setPitchClasses (vector<double> classes)
+{
+    pitch_classes = classes;
+    repaint();
+}
+
+void TuningVisualizer::timerCallback()
+{
+    bool changed = false;
+    for (int channel = 0; channel < 16; channel++)
+    {
+        float new_pitch = audioProcessor.live_pitch[channel].load (std::memory_order_relaxed);
+        bool new_active = audioProcessor.live_active[channel].load (std::memory_order_relaxed);
+        changed = changed || new_active != active[channel] || (new_active && new_pitch != pitch[channel]);
+        pitch[channel] = new_pitch;
+        active[channel] = new_active;
+    }
+    juce::uint64 new_shed_events = audioProcessor.shed_events.load (std::memory_order_relaxed);
+    changed = changed || new_shed_events != shed_events;
+    shed_events = new_shed_events;
+    if (changed) repaint();
+}
+
+//==============================================================================
+void TuningVisualizer::paint (juce::Graphics& g)
+{
+    float width = (float) getWidth();
+    float height = (float) getHeight();
+    float row = height / 16;
+
+    g.fillAll (juce::Colours::black);
+
+    // 12-ET reference grid
+    g.setColour (juce::Colours::darkgrey);
+    for (int semitone = 0; semitone < 12; semitone++)
+        g.drawVerticalLine ((int) (semitone * width / 12), 0, height);
+
+    // Pitches the loaded tuning can play
+    g.setColour (juce::Colours::lightgreen);
+    for (double pitch_class : pitch_classes)
+        g.drawVerticalLine ((int) (pitch_class * width / 12), 0, height);
+
+    // One row per MPE channel
+    g.setColour (juce::Colours::orange);
+    for (int channel = 0; channel < 16; channel++)
+    {
+        if (!active[channel]) continue;
+        float pitch_class = fmodf (pitch[channel], 12.0f);
+        if (pitch_class < 0) pitch_class += 12;
+        float x = pitch_class * width / 12;
+        g.fillEllipse (x - row / 2, channel * row, row, row);
+    }
+
+    // Pitch wheel events coalesced under overload
+    if (shed_events > 0)
+    {
+        g.setColour (juce::Colours::white);
+        g.setFont (12.0f);
+        g.drawText ("Overload: " + juce::String ((juce::int64) shed_events) + " bends coalesced",
+                    4, getHeight() - 16, getWidth() - 8, 14, juce::Justification::right);
+    }
+}
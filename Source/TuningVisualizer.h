@@ -0,0 +1,41 @@
+/*
+  ==============================================================================
+
+    Shows the loaded scale and the live pitch of each MPE channel.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+//==============================================================================
+/** One octave laid out left to right, with a line for every pitch the tuning can
+    play and a dot per sounding channel. Polls the processor's live pitch
+    snapshot on a timer; nothing here blocks the audio thread.
+*/
+class TuningVisualizer  : public juce::Component,
+                          private juce::Timer
+{
+public:
+    TuningVisualizer (NewProjectAudioProcessor&);
+    ~TuningVisualizer() override;
+
+    void setPitchClasses (vector<double> pitch_classes);
+
+    //==============================================================================
+    void paint (juce::Graphics&) override;
+
+private:
+    void timerCallback() override;
+
+    NewProjectAudioProcessor& audioProcessor;
+    vector<double> pitch_classes;
+    float pitch[16] = {};
+    bool active[16] = {};
+    juce::uint64 shed_events = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TuningVisualizer)
+};
@@ -0,0 +1,172 @@
+/*
+  ==============================================================================
+
+    MIDI 2.0 Universal MIDI Packets carrying per-note pitch.
+
+  ==============================================================================
+*/
+
+#include "UMP.h"
+#include <math.h>
+
+const uint32_t ump_type_system = 0x1;
+const uint32_t ump_type_midi1 = 0x2;
+const uint32_t ump_type_midi2 = 0x4;
+
+const uint32_t status_note_off = 0x8;
+const uint32_t status_note_on = 0x9;
+const uint32_t status_per_note_controller = 0x0;
+
+const uint32_t attribute_pitch_7_9 = 0x3;
+const uint32_t per_note_controller_pitch_7_25 = 3;
+
+uint32_t midi2_header(uint32_t status, int channel, int note, uint32_t index)
+{
+  return ump_type_midi2 << 28 | status << 20 | (uint32_t) (channel - 1) << 16 | (uint32_t) note << 8 | index;
+}
+
+// 7-bit velocity to 16 bits, using the MIDI 2.0 min-center-max scaling.
+uint32_t scale_velocity(int velocity)
+{
+  uint32_t scaled = (uint32_t) velocity << 9;
+  if (velocity <= 64) return scaled;
+  uint32_t repeat = ((uint32_t) velocity & 0x3f) << 3;
+  while (repeat != 0)
+  {
+    scaled |= repeat;
+    repeat >>= 6;
+  }
+  return scaled;
+}
+
+double clamp_pitch(double pitch)
+{
+  return pitch < 0 ? 0 : (pitch > 127.999 ? 127.999 : pitch);
+}
+
+uint16_t pitch_7_9(double pitch)
+{
+  return (uint16_t) lround(clamp_pitch(pitch) * 512);
+}
+
+uint32_t pitch_7_25(double pitch)
+{
+  return (uint32_t) llround(clamp_pitch(pitch) * 33554432.0);
+}
+
+// Length of a MIDI 1.0 message from its status byte, 0 for SysEx and undefined ones.
+int midi1_length(uint8_t status)
+{
+  switch (status & 0xf0)
+  {
+    case 0xc0: case 0xd0: return 2;
+    case 0xf0: break;
+    default: return 3;
+  }
+  switch (status)
+  {
+    case 0xf1: case 0xf3: return 2;
+    case 0xf2: return 3;
+    case 0xf6: case 0xf8: case 0xfa: case 0xfb: case 0xfc: case 0xfe: case 0xff: return 1;
+    default: return 0;
+  }
+}
+
+//==============================================================================
+int ump_note_on(uint32_t *words, int channel, int note, int velocity, uint16_t pitch)
+{
+  words[0] = midi2_header(status_note_on, channel, note, attribute_pitch_7_9);
+  words[1] = scale_velocity(velocity) << 16 | pitch;
+  return 2;
+}
+
+int ump_note_off(uint32_t *words, int channel, int note, int velocity)
+{
+  words[0] = midi2_header(status_note_off, channel, note, 0);
+  words[1] = scale_velocity(velocity) << 16;
+  return 2;
+}
+
+int ump_note_pitch(uint32_t *words, int channel, int note, uint32_t pitch)
+{
+  words[0] = midi2_header(status_per_note_controller, channel, note, per_note_controller_pitch_7_25);
+  words[1] = pitch;
+  return 2;
+}
+
+int ump_midi1(uint32_t *words, const uint8_t *data, int size)
+{
+  int length = size > 0 ? midi1_length(data[0]) : 0;
+  if (length == 0 || size < length) return 0;
+  
+  uint32_t type = data[0] >= 0xf0 ? ump_type_system : ump_type_midi1;
+  words[0] = type << 28 | (uint32_t) data[0] << 16
+           | (length > 1 ? (uint32_t) data[1] << 8 : 0) | (length > 2 ? (uint32_t) data[2] : 0);
+  return 1;
+}
+
+int ump_packet_words(uint32_t first_word)
+{
+  switch (first_word >> 28)
+  {
+    case 0x0: case 0x1: case 0x2: case 0x6: case 0x7: return 1;
+    case 0x3: case 0x4: case 0x8: case 0x9: case 0xa: return 2;
+    case 0xb: case 0xc: return 3;
+    default: return 4;
+  }
+}
+
+//==============================================================================
+int write_pitch_wheel(uint8_t *out, int channel_bits, int note, double pitch, double bend_range)
+{
+  long pitchbend = lround((pitch - note) * 8192 / bend_range) + 8192;
+  pitchbend = pitchbend < 0 ? 0 : (pitchbend > 16383 ? 16383 : pitchbend);
+  out[0] = (uint8_t) (0xe0 | channel_bits);
+  out[1] = (uint8_t) (pitchbend & 0x7f);
+  out[2] = (uint8_t) (pitchbend >> 7);
+  return 3;
+}
+
+int ump_to_midi1(const uint32_t *words, double bend_range, uint8_t *out)
+{
+  uint32_t type = words[0] >> 28;
+  if (type == ump_type_midi1 || type == ump_type_system)
+  {
+    out[0] = (uint8_t) (words[0] >> 16);
+    int length = midi1_length(out[0]);
+    if (length == 0 || (type == ump_type_system) != (out[0] >= 0xf0)) return 0;
+    out[1] = (uint8_t) (words[0] >> 8) & 0x7f;
+    out[2] = (uint8_t) words[0] & 0x7f;
+    return length;
+  }
+  if (type != ump_type_midi2) return 0;
+
+  uint32_t status = (words[0] >> 20) & 0xf;
+  int channel_bits = (words[0] >> 16) & 0xf;
+  int note = (words[0] >> 8) & 0x7f;
+  uint32_t index = words[0] & 0xff;
+
+  if (status == status_note_on)
+  {
+    int length = 0;
+    if (index == attribute_pitch_7_9)
+      length = write_pitch_wheel(out, channel_bits, note, (words[1] & 0xffff) / 512.0, bend_range);
+    uint8_t velocity = (uint8_t) (words[1] >> 25);
+    out[length] = (uint8_t) (0x90 | channel_bits);
+    out[length + 1] = (uint8_t) note;
+    out[length + 2] = velocity == 0 ? 1 : velocity;  // MIDI 2.0 velocity 0 is still a note-on
+    return length + 3;
+  }
+  if (status == status_note_off)
+  {
+    out[0] = (uint8_t) (0x80 | channel_bits);
+    out[1] = (uint8_t) note;
+    out[2] = (uint8_t) (words[1] >> 25);
+    return 3;
+  }
+  if (status == status_per_note_controller && index == per_note_controller_pitch_7_25)
+  {
+    return write_pitch_wheel(out, channel_bits, note, words[1] / 33554432.0, bend_range);
+  }
+  return 0;
+}
@@ -0,0 +1,40 @@
+/*
+  ==============================================================================
+
+    MIDI 2.0 Universal MIDI Packets carrying per-note pitch.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+
+//==============================================================================
+// MIDI 2.0 channel voice messages are two 32-bit words; MIDI 1.0 channel voice and
+// system messages wrapped in a packet are one. Everything here uses group 0.
+//
+// A retuned note needs no pitch wheel: the note-on carries its pitch as the Pitch 7.9
+// attribute, and later bends are Registered Per-Note Controller 3 (Pitch 7.25). Both
+// are absolute, so they carry no bend range and no 14-bit quantisation.
+// ump_to_midi1() converts them back for MIDI 1.0 receivers.
+
+const int ump_max_words = 2;
+
+// Absolute pitch formats: 7 bits of note number and 9 or 25 bits of fraction.
+uint16_t pitch_7_9(double pitch);
+uint32_t pitch_7_25(double pitch);
+
+int ump_note_on(uint32_t *words, int channel, int note, int velocity, uint16_t pitch);
+int ump_note_off(uint32_t *words, int channel, int note, int velocity);
+int ump_note_pitch(uint32_t *words, int channel, int note, uint32_t pitch);
+
+// Wraps a MIDI 1.0 channel voice or system common/real-time message. Returns the number
+// of words written, or 0 for SysEx, which needs data packets of its own.
+int ump_midi1(uint32_t *words, const uint8_t *data, int size);
+
+// Converts one packet back to MIDI 1.0 bytes, turning per-note pitch into a channel
+// pitch wheel for the given bend range. Returns the number of bytes written to out
+// (at most 6), or 0 if the packet has no MIDI 1.0 equivalent.
+int ump_to_midi1(const uint32_t *words, double bend_range, uint8_t *out);
+int ump_packet_words(uint32_t first_word);
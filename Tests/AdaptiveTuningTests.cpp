@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+    Adaptive just intonation: corrections, and the cost of a block of note events.
+
+  ==============================================================================
+*/
+
+#include "AdaptiveTuning.h"
+#include "Check.h"
+#include <chrono>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+void testMajorTriad()
+{
+    AdaptiveTuning adaptive;
+    adaptive.noteOn(1, 60);
+    adaptive.noteOn(2, 64);
+    adaptive.noteOn(3, 67);
+    CHECK_NEAR(adaptive.correction[0], 0, 1e-9);
+    CHECK_NEAR(adaptive.correction[1], -0.137, 0.001);  // 5/4
+    CHECK_NEAR(adaptive.correction[2], 0.020, 0.001);   // 3/2
+}
+
+// A lower note becomes the root, and releasing it hands the root back.
+void testRootChanges()
+{
+    AdaptiveTuning adaptive;
+    adaptive.noteOn(2, 64);
+    adaptive.noteOn(3, 67);
+    int changed = adaptive.noteOn(1, 60);
+    CHECK(changed == 0b110);
+    CHECK_NEAR(adaptive.correction[1], -0.137, 0.001);
+    
+    adaptive.noteOff(1);
+    CHECK_NEAR(adaptive.correction[1], 0, 1e-9);       // 64 is the root now
+    CHECK_NEAR(adaptive.correction[2], 0.156, 0.001);  // 6/5 above it
+}
+
+// A note-on on the root's channel without a note-off in between moves the root.
+void testRootReplacedWithoutNoteOff()
+{
+    AdaptiveTuning adaptive;
+    adaptive.noteOn(1, 60);
+    adaptive.noteOn(2, 64);
+    adaptive.noteOn(3, 67);
+    adaptive.noteOn(1, 62);
+    CHECK_NEAR(adaptive.correction[0], 0, 1e-9);
+    CHECK_NEAR(adaptive.correction[1], 0.039, 0.001);   // 9/8 above 62
+    CHECK_NEAR(adaptive.correction[2], -0.020, 0.001);  // 4/3 above 62
+    
+    adaptive.noteOn(1, 70);  // the root moves up to 64
+    CHECK_NEAR(adaptive.correction[1], 0, 1e-9);
+    CHECK_NEAR(adaptive.correction[2], 0.156, 0.001);
+}
+
+// Benchmark: the worst case is every event moving the root, so every held note is revisited.
+// At 64 samples and 96 kHz, processBlock's overload budget is a quarter of 667 us; the
+// adaptive analysis of even a dense block must fit well inside it.
+void testBlockBudget()
+{
+    const int events_per_block = 256;
+    const int blocks = 2000;
+    const double budget_us = 64 / 96000.0 * 0.25 * 1e6;
+    
+    AdaptiveTuning adaptive;
+    for (int channel = 1; channel <= 16; channel++) adaptive.noteOn(channel, 60 + channel);
+    
+    vector<double> block_us;
+    int sink = 0;
+    for (int block = 0; block < blocks; block++)
+    {
+        auto start = chrono::steady_clock::now();
+        for (int event = 0; event < events_per_block; event++)
+        {
+            int channel = 1 + event % 16;
+            sink |= adaptive.noteOff(channel);
+            sink |= adaptive.noteOn(channel, 40 + (event * 7 + block) % 48);
+        }
+        block_us.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+    sort(block_us.begin(), block_us.end());
+    double median = block_us[blocks / 2];
+    double p99 = block_us[blocks * 99 / 100];
+    printf("adaptive: %d note events per block, median %.1f us, 99th percentile %.1f us, budget %.1f us (%d)\n",
+           events_per_block * 2, median, p99, budget_us, sink & 1);
+    CHECK(p99 < budget_us);
+}
+
+int main()
+{
+    testMajorTriad();
+    testRootChanges();
+    testRootReplacedWithoutNoteOff();
+    testBlockBudget();
+    return finish("AdaptiveTuningTests");
+}
@@ -0,0 +1,28 @@
+/*
+  ==============================================================================
+
+    Minimal checks shared by the standalone tests.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <cmath>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { failures++; printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { double a_ = (actual), e_ = (expected); \
+         if (!(fabs(a_ - e_) <= (tolerance))) { failures++; \
+             printf("%s:%d: %s is %g, expected %g\n", __FILE__, __LINE__, #actual, a_, e_); } } while (0)
+
+static int finish(const char *name)
+{
+    printf("%s: %s\n", name, failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
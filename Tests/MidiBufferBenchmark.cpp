@@ -0,0 +1,153 @@
+/*
+  ==============================================================================
+
+    How long processBlock's MIDI output takes to build for a CC-heavy MPE stream.
+
+    JUCE isn't available to the standalone tests, so MidiBuffer is modelled: the
+    same [int32 time][uint16 size][bytes] storage, and an addEvent() that scans
+    from the start for the first later event and inserts there, as JUCE's does.
+    Events go in the way processBlock adds them: everything but notes and pitch
+    wheel on its raw bytes, each member bend as one retuned bend.
+
+    Run with: make -C Tests benchmark
+
+  ==============================================================================
+*/
+
+#include "Check.h"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+const int block_size = 512;
+const int event_spacing = 44;    // samples between each channel's events
+const int blocks = 2000;
+const size_t midi_event_size_estimate = 12;  // as in PluginProcessor.cpp
+
+struct ModelMidiBuffer {
+    vector<uint8_t> data;
+
+    static int timeAt(const uint8_t *d) { int32_t time; memcpy(&time, d, 4); return time; }
+    static int sizeAt(const uint8_t *d) { uint16_t size; memcpy(&size, d + 4, 2); return size; }
+
+    void ensureSize(size_t bytes) { data.reserve(bytes); }
+    void clear() { data.clear(); }
+
+    // Scanned bytes are counted, so the work done can be reported as well as the time.
+    void addEvent(const uint8_t *bytes, int size, int time, long *scanned)
+    {
+        size_t offset = 0;
+        while (offset < data.size() && timeAt(&data[offset]) <= time) offset += 6 + sizeAt(&data[offset]);
+        *scanned += (long) offset;
+
+        uint8_t header[6];
+        int32_t time32 = time;
+        uint16_t size16 = (uint16_t) size;
+        memcpy(header, &time32, 4);
+        memcpy(header + 4, &size16, 2);
+        data.insert(data.begin() + offset, header, header + 6);
+        data.insert(data.begin() + offset + 6, bytes, bytes + size);
+    }
+};
+
+struct Event {
+    int time;
+    int size;
+    uint8_t bytes[3];
+};
+
+// 15 member channels, each sending CC74, channel pressure and a pitch bend every
+// event_spacing samples, staggered so the channels don't all land on one sample.
+vector<Event> mpeStream()
+{
+    vector<Event> events;
+    for (int start = 0; start < block_size; start += event_spacing)
+    {
+        for (int channel = 1; channel < 16; channel++)
+        {
+            int time = start + channel;
+            if (time >= block_size) continue;
+            uint8_t value = (uint8_t) ((start + channel * 7) & 0x7F);
+            events.push_back({ time, 3, { (uint8_t) (0xB0 | channel), 74, value } });
+            events.push_back({ time, 2, { (uint8_t) (0xD0 | channel), value, 0 } });
+            events.push_back({ time, 3, { (uint8_t) (0xE0 | channel), value, 0x40 } });
+        }
+    }
+    return events;
+}
+
+// PluginProcessor.cpp's passes_through().
+bool passesThrough(const Event& event)
+{
+    int status = event.bytes[0] & 0xF0;
+    return status != 0x80 && status != 0x90 && status != 0xE0;
+}
+
+void processEvents(const vector<Event>& events, ModelMidiBuffer *out, bool reserve, long *scanned)
+{
+    out->clear();
+    if (reserve) out->ensureSize(events.size() * 2 * midi_event_size_estimate);
+    for (const Event& event : events)
+    {
+        if (passesThrough(event))
+        {
+            out->addEvent(event.bytes, event.size, event.time, scanned);
+        }
+        else
+        {
+            uint8_t bend[3] = { event.bytes[0], (uint8_t) (event.bytes[1] ^ 0x15), event.bytes[2] };  // retuned
+            out->addEvent(bend, 3, event.time, scanned);
+        }
+    }
+}
+
+// The output holds the input's events in the same order, bends retuned.
+void testOrder(const vector<Event>& events, const ModelMidiBuffer& out)
+{
+    size_t offset = 0;
+    for (const Event& event : events)
+    {
+        CHECK(offset < out.data.size());
+        if (offset >= out.data.size()) return;
+        const uint8_t *d = &out.data[offset];
+        CHECK(ModelMidiBuffer::timeAt(d) == event.time);
+        CHECK(ModelMidiBuffer::sizeAt(d) == event.size);
+        CHECK(d[6] == event.bytes[0]);
+        CHECK(passesThrough(event) ? d[7] == event.bytes[1] : d[7] == (event.bytes[1] ^ 0x15));
+        offset += 6 + event.size;
+    }
+    CHECK(offset == out.data.size());
+}
+
+double microsecondsPerBlock(const vector<Event>& events, bool reserve, long *scanned)
+{
+    ModelMidiBuffer out;
+    auto start = chrono::steady_clock::now();
+    for (int block = 0; block < blocks; block++)
+    {
+        out = ModelMidiBuffer();  // processBlock starts each block with a fresh buffer
+        processEvents(events, &out, reserve, scanned);
+    }
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    testOrder(events, out);
+    return elapsed * 1e6 / blocks;
+}
+
+int main()
+{
+    vector<Event> events = mpeStream();
+    int passed = 0;
+    for (const Event& event : events) passed += passesThrough(event);
+    printf("%d events per %d-sample block, %d passed through\n", (int) events.size(), block_size, passed);
+
+    long scanned = 0;
+    double reserved = microsecondsPerBlock(events, true, &scanned);
+    printf("addEvent() per event, buffer sized up front: %.1f us per block, %ld bytes scanned\n",
+           reserved, scanned / blocks);
+    scanned = 0;
+    double growing = microsecondsPerBlock(events, false, &scanned);
+    printf("addEvent() per event, buffer grown as needed: %.1f us per block\n", growing);
+    return finish("MidiBufferBenchmark");
+}
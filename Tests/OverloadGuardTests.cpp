@@ -0,0 +1,126 @@
+/*
+  ==============================================================================
+
+    Overload protection under a burst of events far denser than a block can retune.
+
+  ==============================================================================
+*/
+
+#include "OverloadGuard.h"
+#include "Check.h"
+#include <chrono>
+#include <cstdio>
+using namespace std;
+
+const double sample_rate = 48000;
+const int block_size = 64;
+const int burst_size = 10000;
+const double event_cost = 1e-6;  // stands in for retuning one event, in seconds
+
+struct Result {
+    double elapsed;       // seconds, for information only
+    int notes;            // note events passed through
+    int bends;            // pitch bends passed through, held ones included
+    int last_bend[16];
+    int shed;
+    int work_before;      // events retuned before the guard tripped
+    int work_after;       // and after it, held bends included
+    int notes_after;
+    bool overloaded;
+};
+
+// Takes at least event_cost of wall-clock time, however busy the machine is.
+void work()
+{
+    auto until = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(event_cost));
+    while (chrono::steady_clock::now() < until) {}
+}
+
+// Bends on channels 2-16, with a note on or off every 50th event, handled the way
+// processBlock handles them: OverloadGuard::hold() decides, work() stands in for retuning.
+Result runBurst(bool enabled)
+{
+    Result result {};
+    for (int c = 0; c < 16; c++) result.last_bend[c] = -1;
+    OverloadGuard guard;
+    guard.prepare(sample_rate);
+    auto retune = [&] { work(); (guard.isOverloaded() ? result.work_after : result.work_before)++; };
+    
+    auto start = chrono::steady_clock::now();
+    guard.beginBlock(block_size, enabled);
+    for (int i = 0; i < burst_size; i++)
+    {
+        int channel = 2 + i % 15;
+        int time = i * block_size / burst_size;
+        bool note = i % 50 == 0;
+        bool flush;
+        if (guard.hold(channel, !note, note, i, time, &flush)) continue;
+        if (flush)
+        {
+            int bend_time;
+            result.last_bend[channel-1] = guard.take(channel, &bend_time);
+            result.bends++;
+            retune();
+        }
+        retune();
+        if (note && guard.isOverloaded()) result.notes_after++;
+        if (note) result.notes++;
+        else { result.last_bend[channel-1] = i; result.bends++; }
+    }
+    for (int channel = 1; channel <= 16 && guard.isOverloaded(); channel++)
+    {
+        if (guard.pending(channel))
+        {
+            int bend_time;
+            result.last_bend[channel-1] = guard.take(channel, &bend_time);
+            result.bends++;
+            retune();
+        }
+    }
+    result.elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.shed = guard.shedCount();
+    result.overloaded = guard.isOverloaded();
+    return result;
+}
+
+// Checks the work done rather than the time taken, so a loaded machine can't fail it:
+// each retuned event takes at least event_cost, so the guard must trip within the budget's
+// worth of events, and after that only notes and the bends held before them are retuned.
+void testBurst()
+{
+    const double block_seconds = block_size / sample_rate;
+    Result unprotected = runBurst(false);
+    Result protected_ = runBurst(true);
+    int budget_events = (int) (block_seconds * overload_budget / event_cost);
+    double work_seconds = (protected_.work_before + protected_.work_after) * event_cost;
+    printf("burst of %d events, block of %.0f us: %d events retuned unprotected, %d protected "
+           "(%d after the guard tripped), %d bends coalesced away; %.0f us unprotected, %.0f us protected\n",
+           burst_size, block_seconds * 1e6, unprotected.work_before, protected_.work_before + protected_.work_after,
+           protected_.work_after, protected_.shed, unprotected.elapsed * 1e6, protected_.elapsed * 1e6);
+    
+    CHECK(!unprotected.overloaded);
+    CHECK(unprotected.shed == 0);
+    CHECK(unprotected.work_before == burst_size);
+    CHECK(protected_.overloaded);
+    CHECK(protected_.work_before <= budget_events + overload_check_interval);
+    CHECK(protected_.work_after <= 2 * protected_.notes_after + 15);
+    CHECK(work_seconds < block_seconds);
+    CHECK(protected_.notes == unprotected.notes);  // notes are never dropped
+    CHECK(protected_.bends + protected_.shed == unprotected.bends);
+    for (int c = 1; c < 16; c++) CHECK(protected_.last_bend[c] == unprotected.last_bend[c]);
+}
+
+void testDisabledWithoutSampleRate()
+{
+    OverloadGuard guard;
+    guard.beginBlock(block_size, true);  // not prepared yet
+    bool flush;
+    for (int i = 0; i < 1000; i++) CHECK(!guard.hold(2, true, false, i, 0, &flush) && !flush);
+}
+
+int main()
+{
+    testBurst();
+    testDisabledWithoutSampleRate();
+    return finish("OverloadGuardTests");
+}
@@ -0,0 +1,47 @@
+/*
+  ==============================================================================
+
+    Pitch CV scaling and the glide between pitches.
+
+  ==============================================================================
+*/
+
+#include "PitchCV.h"
+#include "Check.h"
+
+// 1V/oct with middle C at 0V, and 10V at full scale.
+void testScaling()
+{
+    CHECK_NEAR(semitones_to_cv(60), 0, 1e-7);
+    CHECK_NEAR(semitones_to_cv(72), 0.1, 1e-7);
+    CHECK_NEAR(semitones_to_cv(48), -0.1, 1e-7);
+    CHECK_NEAR(semitones_to_cv(60.5), 0.5 / 120, 1e-7);  // quarter tones keep their fraction
+    CHECK_NEAR(semitones_to_cv(180), 1, 1e-6);           // ten octaves up is full scale
+}
+
+// The ramp starts one step past start and ends on the target, with nothing written past it.
+void testRamp()
+{
+    const int ramp_samples = 8;
+    float start = semitones_to_cv(60);
+    float target = semitones_to_cv(67);
+    float step = (target - start) / ramp_samples;
+    
+    float out[ramp_samples + 1];
+    out[ramp_samples] = -5;
+    render_ramp(out, ramp_samples, start, step);
+    CHECK_NEAR(out[0], start + step, 1e-7);
+    for (int i = 1; i < ramp_samples; i++) CHECK(out[i] > out[i-1]);
+    CHECK_NEAR(out[ramp_samples - 1], target, 1e-6);
+    CHECK(out[ramp_samples] == -5);
+    
+    render_ramp(out, 0, start, step);  // an empty range is fine
+    CHECK(out[0] > start);
+}
+
+int main()
+{
+    testScaling();
+    testRamp();
+    return finish("PitchCVTests");
+}
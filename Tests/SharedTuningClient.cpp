@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    Test client for tuning master mode: maps the shared tuning file and prints
+    what an instance in tuning master mode is publishing.
+
+        SharedTuningClient [path] [--watch]
+
+    path defaults to /tmp/ScalaMPE.tuning, where the plugin writes it. With --watch it keeps
+    printing the table each time its version changes.
+
+  ==============================================================================
+*/
+
+#include "SharedTuningSegment.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    string path = shared_tuning_path;
+    bool watch = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) == "--watch") watch = true;
+        else path = argv[i];
+    }
+    
+    int file = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (file < 0 || fstat(file, &info) != 0 || info.st_size < (off_t) sizeof(SharedTuningSegment))
+    {
+        fprintf(stderr, "No shared tuning at %s\n", path.c_str());
+        return 1;
+    }
+    void *data = mmap(nullptr, sizeof(SharedTuningSegment), PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (data == MAP_FAILED || !is_shared_tuning_segment(static_cast<const SharedTuningSegment*>(data)))
+    {
+        fprintf(stderr, "%s is not a shared tuning\n", path.c_str());
+        return 1;
+    }
+    const SharedTuningSegment *segment = static_cast<const SharedTuningSegment*>(data);
+    
+    uint32_t shown = 0;
+    do
+    {
+        double hz;
+        uint32_t version;
+        if (!read_shared_tuning(segment, 0, hz, &version))
+        {
+            if (!watch)
+            {
+                fprintf(stderr, "No tuning master is publishing\n");
+                return 1;
+            }
+        }
+        else if (version != shown)
+        {
+            printf("version %u\n", version);
+            for (int note = 0; note < 128; note++)
+            {
+                if (!read_shared_tuning(segment, note, hz)) continue;
+                if (hz == 0) printf("%3d  unmapped\n", note);
+                else printf("%3d  %10.4f Hz  %+8.3f cents from 12-ET\n", note, hz, 1200 * log2(hz / 440) - (note - 69) * 100);
+            }
+            shown = version;
+        }
+        if (watch) this_thread::sleep_for(chrono::milliseconds(100));
+    } while (watch);
+    return 0;
+}
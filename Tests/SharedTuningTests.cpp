@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    The shared tuning seqlock: readers never see a table half written.
+
+  ==============================================================================
+*/
+
+#include "SharedTuningSegment.h"
+#include "Check.h"
+#include <thread>
+#include <atomic>
+#include <vector>
+using namespace std;
+
+// Table n has every note at n * 1000 + note, so a torn read mixes two values of n.
+void fill(double *frequency, int n)
+{
+    for (int note = 0; note < 128; note++) frequency[note] = n * 1000.0 + note;
+}
+
+void testReadWrite()
+{
+    SharedTuningSegment segment {};
+    segment.magic = shared_tuning_magic;
+    segment.layout_version = shared_tuning_layout_version;
+    double hz;
+    CHECK(is_shared_tuning_segment(&segment));
+    CHECK(!read_shared_tuning(&segment, 69, hz));  // nothing published yet
+    
+    double frequency[128];
+    fill(frequency, 1);
+    write_shared_tuning(&segment, frequency);
+    CHECK(read_shared_tuning(&segment, 69, hz));
+    CHECK_NEAR(hz, 1069, 0);
+    CHECK(!read_shared_tuning(&segment, 128, hz));
+    
+    write_shared_tuning(&segment, nullptr, false);  // the master closes
+    CHECK(!read_shared_tuning(&segment, 69, hz));
+}
+
+// One writer publishing as fast as it can, readers checking that two notes read under the
+// same version always come from the same table.
+void testNoTornReads()
+{
+    SharedTuningSegment segment {};
+    atomic<bool> running { true };
+    atomic<long> consistent { 0 };
+    atomic<long> torn { 0 };
+    
+    thread writer([&]
+    {
+        double frequency[128];
+        for (int n = 1; running; n++)
+        {
+            fill(frequency, n);
+            write_shared_tuning(&segment, frequency);
+        }
+    });
+    vector<thread> readers;
+    for (int r = 0; r < 3; r++)
+    {
+        readers.emplace_back([&, r]
+        {
+            for (int i = 0; i < 200000; i++)
+            {
+                int note = (i + r) % 128;
+                double first, second;
+                uint32_t first_version, second_version;
+                if (!read_shared_tuning(&segment, note, first, &first_version)) continue;
+                if (!read_shared_tuning(&segment, 127 - note, second, &second_version)) continue;
+                if (first_version != second_version) continue;
+                if ((long) first / 1000 == (long) second / 1000) consistent++;
+                else torn++;
+            }
+        });
+    }
+    for (auto& reader : readers) reader.join();
+    running = false;
+    writer.join();
+    
+    printf("shared tuning: %ld same-version read pairs, %ld torn\n", consistent.load(), torn.load());
+    CHECK(torn == 0);
+    CHECK(consistent > 0);
+}
+
+int main()
+{
+    testReadWrite();
+    testNoTornReads();
+    return finish("SharedTuningTests");
+}
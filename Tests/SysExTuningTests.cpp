@@ -0,0 +1,200 @@
+/*
+  ==============================================================================
+
+    Tunings received over SysEx: scale uploads and MTS bulk dumps, valid or not.
+
+  ==============================================================================
+*/
+
+#include "SysExTuning.h"
+#include "Check.h"
+#include <memory>
+#include <vector>
+#include <string>
+using namespace std;
+
+vector<uint8_t> scale_upload(const string& text)
+{
+    vector<uint8_t> data = { 0xF0, 0x7D, 'S', 'C', 'L' };
+    data.insert(data.end(), text.begin(), text.end());
+    data.push_back(0xF7);
+    return data;
+}
+
+// Bulk dump of the given pitches, in semitones. banked adds the bank byte. Pitches below 0
+// stand for the "no change" entry, 7F 7F 7F.
+vector<uint8_t> bulk_dump(const double *pitch, bool banked = false)
+{
+    vector<uint8_t> data = { 0xF0, 0x7E, 0x7F, 0x08 };
+    if (banked) data.insert(data.end(), { 0x04, 0x01, 0x02 });
+    else data.insert(data.end(), { 0x01, 0x02 });
+    const char *name = "Dump            ";
+    data.insert(data.end(), name, name + 16);
+    for (int note = 0; note < 128; note++)
+    {
+        if (pitch[note] < 0)
+        {
+            data.insert(data.end(), { 0x7F, 0x7F, 0x7F });
+            continue;
+        }
+        int semitone = (int) floor(pitch[note]);
+        int fraction = (int) lround((pitch[note] - semitone) * 16384);
+        data.insert(data.end(), { (uint8_t) semitone, (uint8_t) (fraction >> 7), (uint8_t) (fraction & 0x7F) });
+    }
+    uint8_t checksum = 0;
+    for (size_t i = 1; i < data.size(); i++) checksum ^= data[i];
+    data.push_back(checksum & 0x7F);
+    data.push_back(0xF7);
+    return data;
+}
+
+int interpret(const vector<uint8_t>& data, const Tuning *current, Tuning *tuning, vector<string> *text)
+{
+    int has_error = interpret_tuning_sysex(data.data(), (int) data.size(), current, tuning, text);
+    if (!has_error)
+    {
+        double ranges[2] = { default_member_bend_range, default_master_bend_range };
+        compile_tuning(tuning, ranges);
+    }
+    return has_error;
+}
+
+void testScaleUpload()
+{
+    vector<uint8_t> data = scale_upload("just\n 7\n!\n 9/8\n 5/4\n 4/3\n 3/2\n 5/3\n 15/8\n 2/1\n");
+    CHECK(is_tuning_sysex(data.data(), (int) data.size()));
+    
+    unique_ptr<Tuning> tuning(new Tuning());
+    vector<string> text;
+    CHECK(interpret(data, nullptr, tuning.get(), &text) == 0);
+    CHECK(tuning->scale.description == "just");
+    CHECK(tuning->scale.count == 7);
+    CHECK(!tuning->has_keyboard);
+    CHECK(text[1] == "9/8" && text[0] == "2/1");
+    CHECK_NEAR(tuning->note_pitch[4], 12 * log2(3.0 / 2), 1e-5);  // no mapping: note n plays degree n
+    CHECK_NEAR(tuning->note_pitch[7], 12, 1e-9);
+    
+    vector<uint8_t> malformed = scale_upload("bad\n seven\n");
+    CHECK(interpret(malformed, nullptr, tuning.get(), &text) == 1);
+    vector<uint8_t> no_period = scale_upload("short\n 3\n 100.0\n");
+    unique_ptr<Tuning> short_tuning(new Tuning());
+    CHECK(interpret(no_period, nullptr, short_tuning.get(), &text) == 1);
+}
+
+// Declaring more degrees than the tables hold is refused before anything is written.
+void testOversizedScaleUpload()
+{
+    string text = "big\n 1000\n";
+    for (int degree = 1; degree <= 1000; degree++) text += " " + to_string(degree) + "00.0\n";
+    vector<uint8_t> data = scale_upload(text);
+    unique_ptr<Tuning> tuning(new Tuning());
+    vector<string> degree_text;
+    CHECK(interpret(data, nullptr, tuning.get(), &degree_text) == 1);
+    CHECK(tuning->scale.i == 0);  // scale_array[128] on would overwrite i itself
+    
+    vector<uint8_t> limit = scale_upload("limit\n 129\n 100.0\n");
+    CHECK(interpret(limit, nullptr, tuning.get(), &degree_text) == 1);
+}
+
+void testBulkDump()
+{
+    double pitch[128];
+    for (int note = 0; note < 128; note++) pitch[note] = note + 0.25;
+    
+    for (int banked = 0; banked < 2; banked++)
+    {
+        vector<uint8_t> data = bulk_dump(pitch, banked);
+        CHECK(data.size() == (size_t) mts_bulk_dump_size + banked);
+        CHECK(is_tuning_sysex(data.data(), (int) data.size()));
+        
+        unique_ptr<Tuning> tuning(new Tuning());
+        vector<string> text;
+        CHECK(interpret(data, nullptr, tuning.get(), &text) == 0);
+        CHECK(tuning->scale.description == "Dump");
+        CHECK(tuning->scale.count == 128);
+        CHECK(!tuning->has_keyboard);
+        for (int note = 0; note < 128; note++) CHECK_NEAR(tuning->note_pitch[note], note + 0.25, 1e-4);
+        CHECK(text[69] == "6925.00000");
+    }
+}
+
+// Bends past the ends of a bulk dump carry on from the end keys, rather than wrapping round
+// the 128 degree "scale" it is stored as.
+void testBulkDumpBendsPastTheTable()
+{
+    double pitch[128];
+    for (int note = 0; note < 128; note++) pitch[note] = note;
+    vector<uint8_t> data = bulk_dump(pitch);
+    unique_ptr<Tuning> tuning(new Tuning());
+    vector<string> text;
+    CHECK(interpret(data, nullptr, tuning.get(), &text) == 0);
+    CHECK(tuning->per_key);
+    
+    double range = tuning->bend_range[0];
+    double up = 120 + pitchbend_to_semitones(new_pitchbend(tuning.get(), 0, 120, 16383) - 8192, range);
+    CHECK_NEAR(up, 120 + range * 8191 / 8192, 0.01);
+    double down = 3 + pitchbend_to_semitones(new_pitchbend(tuning.get(), 0, 3, 0) - 8192, range);
+    CHECK_NEAR(down, 3 - range, 0.01);
+}
+
+void testBulkDumpChecksum()
+{
+    double pitch[128];
+    for (int note = 0; note < 128; note++) pitch[note] = note;
+    vector<uint8_t> data = bulk_dump(pitch);
+    data[data.size() - 2] ^= 0x01;
+    
+    unique_ptr<Tuning> tuning(new Tuning());
+    vector<string> text;
+    CHECK(interpret(data, nullptr, tuning.get(), &text) == 1);
+}
+
+// 7F 7F 7F keeps the key's current pitch, and 12-ET without a current tuning.
+void testBulkDumpNoChange()
+{
+    double pitch[128];
+    for (int note = 0; note < 128; note++) pitch[note] = note % 2 ? -1 : note + 0.5;
+    vector<uint8_t> data = bulk_dump(pitch);
+    
+    unique_ptr<Tuning> first(new Tuning());
+    vector<string> text;
+    CHECK(interpret(data, nullptr, first.get(), &text) == 0);
+    CHECK_NEAR(first->note_pitch[60], 60.5, 1e-4);
+    CHECK_NEAR(first->note_pitch[61], 61, 1e-9);
+    
+    for (int note = 0; note < 128; note++) pitch[note] = note % 2 ? note - 0.25 : -1;
+    data = bulk_dump(pitch);
+    unique_ptr<Tuning> second(new Tuning());
+    CHECK(interpret(data, first.get(), second.get(), &text) == 0);
+    CHECK_NEAR(second->note_pitch[60], 60.5, 1e-4);   // kept from the first dump
+    CHECK_NEAR(second->note_pitch[61], 60.75, 1e-4);
+}
+
+void testNotTuning()
+{
+    const uint8_t identity[] = { 0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7 };
+    CHECK(!is_tuning_sysex(identity, sizeof(identity)));
+    const uint8_t unterminated[] = { 0xF0, 0x7D, 'S', 'C', 'L', 'x', 0x00 };
+    CHECK(!is_tuning_sysex(unterminated, sizeof(unterminated)));
+    
+    double pitch[128] = {};
+    vector<uint8_t> data = bulk_dump(pitch);
+    data.erase(data.begin() + 30);  // one byte short
+    CHECK(!is_tuning_sysex(data.data(), (int) data.size()));
+    
+    unique_ptr<Tuning> tuning(new Tuning());
+    vector<string> text;
+    CHECK(interpret_tuning_sysex(identity, sizeof(identity), nullptr, tuning.get(), &text) == 1);
+}
+
+int main()
+{
+    testScaleUpload();
+    testOversizedScaleUpload();
+    testBulkDump();
+    testBulkDumpBendsPastTheTable();
+    testBulkDumpChecksum();
+    testBulkDumpNoChange();
+    testNotTuning();
+    return finish("SysExTuningTests");
+}
@@ -0,0 +1,128 @@
+/*
+  ==============================================================================
+
+    Scale parsing, table compilation and retuned pitch bends.
+
+  ==============================================================================
+*/
+
+#include "Tuning.h"
+#include "Check.h"
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+
+const char *equal_scale = "12-ET\n 12\n!\n 100.0\n 200.0\n 300.0\n 400.0\n 500.0\n 600.0\n"
+                          " 700.0\n 800.0\n 900.0\n 1000.0\n 1100.0\n 2/1\n";
+const char *just_scale = "just\n 7\n!\n 9/8\n 5/4\n 4/3\n 3/2\n 5/3\n 15/8\n 2/1\n";
+const char *keyboard_map = "12\n0\n127\n60\n69\n440.0\n12\n0\n1\n2\n3\n4\n5\n6\n7\n8\n9\n10\nx\n";
+
+void load(Tuning *tuning, const char *scale, const char *keyboard = nullptr)
+{
+    istringstream scale_stream(scale);
+    CHECK(interpretFile(&tuning->scale, &scale_stream) == 0);
+    tuning->has_keyboard = keyboard != nullptr;
+    if (keyboard != nullptr)
+    {
+        istringstream keyboard_stream(keyboard);
+        CHECK(interpretKeyboardFile(&tuning->keyboard, &keyboard_stream) == 0);
+    }
+    double ranges[2] = { default_member_bend_range, default_master_bend_range };
+    compile_tuning(tuning, ranges);
+}
+
+// Pitch a bend on a key ends up at, in semitones.
+double bent_pitch(const Tuning *tuning, int note, int pitchbend)
+{
+    return note + pitchbend_to_semitones(new_pitchbend(tuning, 0, note, pitchbend) - 8192, tuning->bend_range[0]);
+}
+
+// Bends past either end of the 128 key table keep following the scale.
+void testBendsPastTheTable()
+{
+    Tuning equal;
+    load(&equal, equal_scale);
+    double full_up = pitchbend_to_semitones(16383 - 8192, 48);
+    CHECK_NEAR(bent_pitch(&equal, 100, 16383), 100 + full_up, 0.01);
+    CHECK_NEAR(bent_pitch(&equal, 120, 16383), 120 + full_up, 0.01);
+    CHECK_NEAR(bent_pitch(&equal, 10, 0), 10 - 48, 0.01);
+    
+    Tuning just;
+    load(&just, just_scale);
+    int period_down = 8192 - (int) semitones_to_pitchbend(7, 48);  // 7 keys per period without a mapping
+    CHECK_NEAR(bent_pitch(&just, 3, period_down), just.note_pitch[3] - 12, 0.01);
+    
+    Tuning mapped;
+    load(&mapped, equal_scale, keyboard_map);
+    int twelve_up = 8192 + (int) semitones_to_pitchbend(12, 48);
+    CHECK_NEAR(bent_pitch(&mapped, 120, twelve_up), mapped.note_pitch[120] + 12, 0.01);
+}
+
+// Editing a degree recompiles only some keys, but must match a full recompile.
+void testCompileDegree()
+{
+    for (int with_keyboard = 0; with_keyboard < 2; with_keyboard++)
+    {
+        Tuning tuning;
+        load(&tuning, just_scale, with_keyboard ? keyboard_map : nullptr);
+        for (int index = 0; index < tuning.scale.count; index++)
+        {
+            unique_ptr<Tuning> edited(new Tuning(tuning));
+            edited->scale.scale_array[index] += 0.37;
+            compile_degree(edited.get(), index);
+            unique_ptr<Tuning> full(new Tuning(*edited));
+            compile_tuning(full.get(), tuning.bend_range);
+            CHECK(memcmp(edited->note_pitch, full->note_pitch, sizeof(full->note_pitch)) == 0);
+            CHECK(memcmp(edited->note_bend, full->note_bend, sizeof(full->note_bend)) == 0);
+        }
+    }
+}
+
+// The degrees are written back as they were read, the period last.
+void testDegreeText()
+{
+    unique_ptr<Tuning> tuning(new Tuning());
+    vector<string> text;
+    istringstream scale_stream(just_scale);
+    CHECK(interpretFile(&tuning->scale, &scale_stream, &text) == 0);
+    CHECK(text[0] == "2/1");
+    CHECK(text[1] == "9/8");
+    CHECK(text[6] == "15/8");
+    
+    string filename = "TuningTests.scl";
+    ofstream out(filename);
+    CHECK(writeFile(&tuning->scale, text, &out) == 0);
+    out.close();
+    
+    unique_ptr<Tuning> reread(new Tuning());
+    vector<string> reread_text;
+    ifstream in(filename);
+    CHECK(interpretFile(&reread->scale, &in, &reread_text) == 0);
+    remove(filename.c_str());
+    CHECK(reread->scale.count == 7);
+    for (int index = 0; index < 7; index++) CHECK(reread_text[index] == text[index]);
+}
+
+// A scale declaring more degrees than the tables hold is refused before any are read.
+void testTooManyDegrees()
+{
+    string text = "big\n 1000\n!\n";
+    for (int degree = 1; degree <= 1000; degree++) text += " " + to_string(degree * 1.2) + "\n";
+    unique_ptr<Tuning> tuning(new Tuning());
+    vector<string> degree_text;
+    istringstream scale_stream(text);
+    CHECK(interpretFile(&tuning->scale, &scale_stream, &degree_text) == 1);
+    CHECK(tuning->scale.i == 0);
+    
+    istringstream negative("negative\n -3\n 100.0\n");
+    CHECK(interpretFile(&tuning->scale, &negative, &degree_text) == 1);
+}
+
+int main()
+{
+    testBendsPastTheTable();
+    testCompileDegree();
+    testDegreeText();
+    testTooManyDegrees();
+    return finish("TuningTests");
+}
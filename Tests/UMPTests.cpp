@@ -0,0 +1,158 @@
+/*
+  ==============================================================================
+
+    MIDI 2.0 packets with per-note pitch against the MIDI 1.0 output.
+
+  ==============================================================================
+*/
+
+#include "UMP.h"
+#include "Tuning.h"
+#include "Check.h"
+#include <sstream>
+#include <memory>
+#include <cstdlib>
+
+const char *just_scale = "just\n 7\n!\n 9/8\n 5/4\n 4/3\n 3/2\n 5/3\n 15/8\n 2/1\n";
+const char *keyboard_map = "12\n0\n127\n60\n69\n440.0\n12\n0\n1\n2\n3\n4\n5\n6\n7\n8\n9\n10\nx\n";
+
+unique_ptr<Tuning> load(const char *keyboard, double member_bend_range)
+{
+    unique_ptr<Tuning> tuning(new Tuning());
+    istringstream scale_stream(just_scale);
+    CHECK(interpretFile(&tuning->scale, &scale_stream) == 0);
+    tuning->has_keyboard = keyboard != nullptr;
+    if (keyboard != nullptr)
+    {
+        istringstream keyboard_stream(keyboard);
+        CHECK(interpretKeyboardFile(&tuning->keyboard, &keyboard_stream) == 0);
+    }
+    double ranges[2] = { member_bend_range, default_master_bend_range };
+    compile_tuning(tuning.get(), ranges);
+    return tuning;
+}
+
+int wheel_value(const uint8_t *bytes)
+{
+    return bytes[1] | bytes[2] << 7;
+}
+
+// True if an absolute pitch format can carry the pitch, and a bend on note can reach it.
+bool representable(double pitch, int note, double bend_range)
+{
+    return pitch >= 0 && pitch < 127.999 && fabs(pitch - note) < bend_range;
+}
+
+// A note-on with its Pitch 7.9 attribute, converted back, gives the pitch wheel from the
+// MIDI 1.0 table. 7.9 has 1/512 semitone steps, coarser than the wheel at small bend ranges.
+void testNoteOnMatchesBendTable()
+{
+    const double ranges[] = { 48, 2 };
+    int checked = 0;
+    for (double range : ranges)
+    {
+        for (int with_keyboard = 0; with_keyboard < 2; with_keyboard++)
+        {
+            unique_ptr<Tuning> tuning = load(with_keyboard ? keyboard_map : nullptr, range);
+            int tolerance = (int) ceil(8192 / range / 1024) + 1;
+            for (int note = 0; note < 128; note++)
+            {
+                if (!tuning->note_mapped[note] || !representable(tuning->note_pitch[note], note, range)) continue;
+                
+                uint32_t words[ump_max_words];
+                CHECK(ump_note_on(words, 3, note, 100, pitch_7_9(tuning->note_pitch[note])) == 2);
+                CHECK(ump_packet_words(words[0]) == 2);
+                uint8_t bytes[6];
+                CHECK(ump_to_midi1(words, range, bytes) == 6);
+                CHECK(bytes[0] == 0xE2 && bytes[3] == 0x92 && bytes[4] == note && bytes[5] == 100);
+                CHECK(abs(wheel_value(bytes) - tuning->note_bend[0][note]) <= tolerance);
+                checked++;
+            }
+        }
+    }
+    CHECK(checked > 100);
+}
+
+// A bend sent as absolute per-note pitch (7.25) lands on the same wheel value as the
+// MIDI 1.0 retuned bend.
+void testBendMatchesNewPitchbend()
+{
+    unique_ptr<Tuning> tuning = load(keyboard_map, default_member_bend_range);
+    const int bends[] = { 0, 2000, 8192, 8300, 12000, 16383 };
+    int checked = 0;
+    for (int note = 40; note < 90; note++)
+    {
+        if (!tuning->note_mapped[note]) continue;
+        for (int bend : bends)
+        {
+            int expected = new_pitchbend(tuning.get(), 0, note, bend);
+            double pitch = note + pitchbend_to_semitones(expected - 8192, tuning->bend_range[0]);
+            if (!representable(pitch, note, tuning->bend_range[0])) continue;
+            
+            uint32_t words[ump_max_words];
+            CHECK(ump_note_pitch(words, 16, note, pitch_7_25(pitch)) == 2);
+            uint8_t bytes[6];
+            CHECK(ump_to_midi1(words, tuning->bend_range[0], bytes) == 3);
+            CHECK(bytes[0] == 0xEF);
+            CHECK(abs(wheel_value(bytes) - expected) <= 1);
+            checked++;
+        }
+    }
+    CHECK(checked > 100);
+}
+
+void testVelocity()
+{
+    uint32_t words[ump_max_words];
+    uint8_t bytes[6];
+    for (int velocity = 0; velocity < 128; velocity++)
+    {
+        ump_note_off(words, 1, 60, velocity);
+        CHECK(ump_to_midi1(words, 48, bytes) == 3);
+        CHECK(bytes[0] == 0x80 && bytes[1] == 60 && bytes[2] == velocity);
+    }
+    CHECK((words[1] >> 16) == 0xFFFF);  // 127 scales to full 16-bit velocity
+    
+    ump_note_on(words, 1, 60, 0, pitch_7_9(60));
+    CHECK(ump_to_midi1(words, 48, bytes) == 6);
+    CHECK(bytes[5] == 1);  // velocity 0 would turn it into a note-off
+}
+
+// Channel voice messages are MIDI 1.0 packets (type 2), system common and real-time
+// messages are system packets (type 1), SysEx isn't wrapped.
+void testMidi1Wrapping()
+{
+    struct { uint8_t data[3]; int size; uint32_t type; } messages[] = {
+        { { 0xB4, 74, 100 }, 3, 0x2 },  // CC74
+        { { 0xD4, 90 }, 2, 0x2 },       // channel pressure
+        { { 0xC0, 5 }, 2, 0x2 },        // program change
+        { { 0xF8 }, 1, 0x1 },           // timing clock
+        { { 0xF2, 0x10, 0x02 }, 3, 0x1 },  // song position
+        { { 0xF3, 7 }, 2, 0x1 },        // song select
+    };
+    for (auto& message : messages)
+    {
+        uint32_t words[ump_max_words];
+        CHECK(ump_midi1(words, message.data, message.size) == 1);
+        CHECK(words[0] >> 28 == message.type);
+        CHECK(ump_packet_words(words[0]) == 1);
+        uint8_t bytes[6];
+        CHECK(ump_to_midi1(words, 48, bytes) == message.size);
+        for (int i = 0; i < message.size; i++) CHECK(bytes[i] == message.data[i]);
+    }
+    
+    uint32_t words[ump_max_words];
+    const uint8_t sysex[] = { 0xF0, 0x7D, 0x01, 0xF7 };
+    CHECK(ump_midi1(words, sysex, sizeof(sysex)) == 0);
+    const uint8_t truncated[] = { 0xB0, 74 };
+    CHECK(ump_midi1(words, truncated, sizeof(truncated)) == 0);
+}
+
+int main()
+{
+    testNoteOnMatchesBendTable();
+    testBendMatchesNewPitchbend();
+    testVelocity();
+    testMidi1Wrapping();
+    return finish("UMPTests");
+}